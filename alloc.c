@@ -0,0 +1,156 @@
+#include "alloc.h"
+
+#ifdef TRACK_ALLOCS
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_ALLOC_SITES 256
+
+typedef struct {
+    const char *file;
+    int line;
+    long allocs;
+    size_t bytes;
+    long live;
+    size_t live_bytes;
+} AllocSite;
+
+// Sits right before every tracked block. pad is the distance from the start
+// of the underlying allocation, so aligned blocks can be freed too.
+typedef struct {
+    size_t size;
+    uint32_t pad;
+    int site;
+} AllocHeader;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static AllocSite sites[MAX_ALLOC_SITES];
+static int sites_count;
+
+static AllocCount frame;
+static long frames;
+static long allocating_frames;
+static AllocCount worst_frame;
+
+static int find_site(const char *file, int line) {
+    for (int i = 0; i < sites_count; i++) {
+	if (sites[i].line == line && strcmp(sites[i].file, file) == 0) {
+	    return i;
+	}
+    }
+
+    assert(sites_count < MAX_ALLOC_SITES && "Too many allocation sites");
+    sites[sites_count] = (AllocSite){.file = file, .line = line};
+    return sites_count++;
+}
+
+static AllocHeader *header_of(void *ptr) {
+    return (AllocHeader *)ptr - 1;
+}
+
+void *track_alloc(size_t align, size_t size, const char *file, int line) {
+    if (align < _Alignof(AllocHeader)) {
+	align = _Alignof(AllocHeader);
+    }
+    size_t pad = (sizeof(AllocHeader) + align - 1) / align * align;
+    size_t total = (pad + size + align - 1) / align * align;
+
+    char *base = aligned_alloc(align, total);
+    if (base == NULL) {
+	return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+    int site = find_site(file, line);
+    sites[site].allocs++;
+    sites[site].bytes += size;
+    sites[site].live++;
+    sites[site].live_bytes += size;
+    frame.allocs++;
+    frame.bytes += size;
+    pthread_mutex_unlock(&lock);
+
+    void *ptr = base + pad;
+    *header_of(ptr) = (AllocHeader){.size = size, .pad = pad, .site = site};
+    return ptr;
+}
+
+void track_free(void *ptr) {
+    if (ptr == NULL) {
+	return;
+    }
+
+    AllocHeader h = *header_of(ptr);
+
+    pthread_mutex_lock(&lock);
+    sites[h.site].live--;
+    sites[h.site].live_bytes -= h.size;
+    pthread_mutex_unlock(&lock);
+
+    free((char *)ptr - h.pad);
+}
+
+void *track_realloc(void *ptr, size_t size, const char *file, int line) {
+    if (ptr == NULL) {
+	return track_alloc(_Alignof(max_align_t), size, file, line);
+    }
+
+    AllocHeader h = *header_of(ptr);
+    void *moved = track_alloc(_Alignof(max_align_t), size, file, line);
+    if (moved == NULL) {
+	return NULL;
+    }
+
+    memcpy(moved, ptr, h.size < size ? h.size : size);
+    track_free(ptr);
+    return moved;
+}
+
+AllocCount end_alloc_frame(void) {
+    pthread_mutex_lock(&lock);
+    AllocCount count = frame;
+    frame = (AllocCount){0};
+    frames++;
+    if (count.allocs > 0) {
+	allocating_frames++;
+    }
+    if (count.bytes > worst_frame.bytes) {
+	worst_frame = count;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return count;
+}
+
+void report_allocs(FILE *f) {
+    pthread_mutex_lock(&lock);
+
+    long leaks = 0;
+    size_t leaked_bytes = 0;
+
+    fprintf(f, "allocations by site:\n");
+    fprintf(f, "%-24s %10s %12s %8s %12s\n", "site", "allocs", "bytes", "live", "live bytes");
+    for (int i = 0; i < sites_count; i++) {
+	AllocSite *s = &sites[i];
+	char name[64];
+	snprintf(name, sizeof(name), "%s:%d", s->file, s->line);
+	fprintf(f, "%-24s %10ld %12zu %8ld %12zu\n", name, s->allocs, s->bytes, s->live, s->live_bytes);
+	leaks += s->live;
+	leaked_bytes += s->live_bytes;
+    }
+
+    fprintf(f, "frames with allocations: %ld of %ld, worst %ld allocs / %zu bytes\n",
+	    allocating_frames, frames, worst_frame.allocs, worst_frame.bytes);
+    if (leaks > 0) {
+	fprintf(f, "leaked: %ld allocations, %zu bytes\n", leaks, leaked_bytes);
+    } else {
+	fprintf(f, "no leaks\n");
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+#endif
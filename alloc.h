@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Allocation tracking for debug builds, enabled with `make TRACK_ALLOCS=1`.
+// Allocations made through the tracked_* macros are counted per call site and
+// per frame, and report_allocs lists whatever is still live at exit. Without
+// TRACK_ALLOCS the macros are the plain libc calls.
+
+typedef struct {
+    long allocs;
+    size_t bytes;
+} AllocCount;
+
+#ifdef TRACK_ALLOCS
+
+#define tracked_malloc(size) track_alloc(_Alignof(max_align_t), (size), __FILE__, __LINE__)
+#define tracked_aligned_alloc(align, size) track_alloc((align), (size), __FILE__, __LINE__)
+#define tracked_realloc(ptr, size) track_realloc((ptr), (size), __FILE__, __LINE__)
+#define tracked_free(ptr) track_free(ptr)
+
+void *track_alloc(size_t align, size_t size, const char *file, int line);
+
+void *track_realloc(void *ptr, size_t size, const char *file, int line);
+
+void track_free(void *ptr);
+
+// Closes the current frame and returns what was allocated during it.
+AllocCount end_alloc_frame(void);
+
+void report_allocs(FILE *f);
+
+#else
+
+#define tracked_malloc(size) malloc(size)
+#define tracked_aligned_alloc(align, size) aligned_alloc((align), (size))
+#define tracked_realloc(ptr, size) realloc((ptr), (size))
+#define tracked_free(ptr) free(ptr)
+
+static inline AllocCount end_alloc_frame(void) {
+    return (AllocCount){0};
+}
+
+static inline void report_allocs(FILE *f) {
+    (void)f;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include "arena.h"
+#include "alloc.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+void init_arena(Arena *a, size_t high_water) {
+    a->base = tracked_malloc(high_water);
+    assert(a->base != NULL && "Can't allocate arena");
+
+    a->high_water = high_water;
+    atomic_init(&a->used, 0);
+    a->peak = 0;
+}
+
+void free_arena(Arena *a) {
+    tracked_free(a->base);
+}
+
+void reset_arena(Arena *a) {
+    size_t used = atomic_load_explicit(&a->used, memory_order_relaxed);
+    if (used > a->peak) {
+	a->peak = used;
+    }
+    atomic_store_explicit(&a->used, 0, memory_order_relaxed);
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    size_t offset = atomic_fetch_add_explicit(&a->used, size, memory_order_relaxed);
+
+    if (offset + size > a->high_water) {
+	fprintf(stderr, "arena: high-water mark exceeded, %zu bytes requested, %zu of %zu in use\n", size, offset, a->high_water);
+	abort();
+    }
+
+    return a->base + offset;
+}
+
+size_t arena_used(Arena *a) {
+    return atomic_load_explicit(&a->used, memory_order_relaxed);
+}
+
+size_t arena_peak(Arena *a) {
+    size_t used = arena_used(a);
+    return used > a->peak ? used : a->peak;
+}
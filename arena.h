@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Bump allocator for data that only lives for one tick. Everything is freed
+// at once by reset_arena. Allocation is lock-free, so jobs can allocate from
+// the same arena concurrently.
+typedef struct {
+    char *base;
+    size_t high_water; // allocations past this mark are a bug, not a slow path
+    atomic_size_t used;
+    size_t peak;
+} Arena;
+
+void init_arena(Arena *a, size_t high_water);
+
+void free_arena(Arena *a);
+
+void reset_arena(Arena *a);
+
+void *arena_alloc(Arena *a, size_t size);
+
+size_t arena_used(Arena *a);
+
+// Largest usage seen by any tick so far.
+size_t arena_peak(Arena *a);
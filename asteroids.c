@@ -2,6 +2,8 @@
 #include "include/raylib.h"
 #include <assert.h>
 
+#define MOVE_ASTEROIDS_GRAIN 1024
+
 /*
 void update_asteroid_veritices(Asteroid *a) {
     for (int i = 0; i < a->vertices.size; i++) {
@@ -13,40 +15,41 @@ void update_asteroid_veritices(Asteroid *a) {
 }
 */
 
-Asteroid* init_asteroid(float x, float y, float direction) {
-    int coords_size = 7;
-    
-    Asteroid* a = malloc(sizeof(Asteroid));
-    assert(a != NULL && "Can't allocate asteroid");
+static const PolarCoords asteroid_shape[] = {
+    {50, 0},
+    {45, (7 * PI) / 4},
+    {30, (4 * PI) / 3},
+    {50, (3 * PI) / 4},
+    {20, PI / 2},
+    {30, PI / 3},
+    {50, PI / 6},
+};
 
-    a->coords = malloc(sizeof(PolarCoords) * coords_size);
-    assert(a->coords != NULL && "Can't allocate coords");
+static_assert(sizeof(asteroid_shape) / sizeof(PolarCoords) <= MAX_ASTEROID_VERTICES,
+	      "Asteroid shape doesn't fit in MAX_ASTEROID_VERTICES");
 
-    a->vector_coords = malloc(sizeof(Vector2) * coords_size);
-    assert(a->vector_coords != NULL && "Can't allocate vector_coords");
+Asteroid init_asteroid(Rng *rng, float x, float y, float direction) {
+    Asteroid asteroid;
+    Asteroid *a = &asteroid;
 
     a->center = (Vector2) {x, y};
-    a->rotation_speed = (float)GetRandomValue(1, 10) / 100;
-    a->move_speed = (float)GetRandomValue(1, 10) / 10;
+    a->rotation_speed = (float)random_value(rng, 1, 10) / 100;
+    a->move_speed = (float)random_value(rng, 1, 10) / 10;
     a->direction = direction;
     a->angle = 0.0;
     a->max_radius = 50;
-    a->coords_size = coords_size;
-
-    // a->coords[7] = (PolarCoords){50, 0};
-    a->coords[6] = (PolarCoords){50, PI / 6};
-    a->coords[5] = (PolarCoords){30, PI / 3};
-    a->coords[4] = (PolarCoords){20, PI / 2};
-    a->coords[3] = (PolarCoords){50, (3 * PI) / 4};
-    a->coords[2] = (PolarCoords){30, (4 * PI) / 3};
-    a->coords[1] = (PolarCoords){45, (7 * PI) / 4};
-    a->coords[0] = (PolarCoords){50, 0};
-
-    for (int i = 0; i < coords_size; i++) {
+    a->coords_size = sizeof(asteroid_shape) / sizeof(PolarCoords);
+    a->coords = asteroid_shape;
+
+    for (int i = 0; i < a->coords_size; i++) {
 	a->vector_coords[i] = polar_to_vector(a->coords[i], a->center, a->angle);
     }
 
-    return a;
+    return asteroid;
+}
+
+void restore_asteroid_shape(Asteroid *a) {
+    a->coords = asteroid_shape;
 }
 
 void move_asteroid(Asteroid *a) {
@@ -62,54 +65,15 @@ void move_asteroid(Asteroid *a) {
     }
 }
 
-void free_asteroid(Asteroid *a) {
-    free(a->vector_coords);
-    free(a->coords);
-    free(a);
-}
-
-AsteroidsVector make_asteroids_vector(int size) {
-    AsteroidsVector v = malloc(sizeof(Asteroid) * size + sizeof(int) * 2);
-    assert(v != NULL && "Can't allocate asteroids vector");
-    
-    *(int*)v = 0; // len
-    v = (AsteroidsVector)((int*)v + 1);
-
-    *(int*)v = size; // cap
-    v = (AsteroidsVector)((int*)v + 1);
-
-    return v;
-}
-
-int asteroids_vector_len(AsteroidsVector v) {
-    return *((int *)v - 2);
-}
-
-int asteroids_vector_cap(AsteroidsVector v) {
-    return *((int *)v - 1);
-}
-
-void append_to_asteroids_vector(AsteroidsVector v, Asteroid *a) {
-    v[asteroids_vector_len(v)] = a;
-    *((int*)v - 2) += 1;
-}
-
-void delete_from_asteroids_vector(AsteroidsVector v, int idx) {
-    Asteroid* a = v[idx];
-    free_asteroid(a);
-    
-    int bytes_to_copy = (asteroids_vector_len(v) - idx - 1) * sizeof(Asteroid*);
-
-    AsteroidsVector ptr1 = v + idx;
-    AsteroidsVector ptr2 = v + idx + 1;
-    memmove(ptr1, ptr2, bytes_to_copy);
-
-    *((int*)v - 2) -= 1;
+static void move_asteroids_range(void *ctx, int begin, int end) {
+    Asteroid *asteroids = ctx;
+    for (int i = begin; i < end; i++) {
+	move_asteroid(&asteroids[i]);
+    }
 }
 
-void free_asteroid_vector(AsteroidsVector v) {
-    v = (AsteroidsVector)((int*)v - 2);
-    free(v);
+void move_asteroids(JobSystem *js, AsteroidsVector v) {
+    parallel_for(js, asteroids_vector_len(v), MOVE_ASTEROIDS_GRAIN, move_asteroids_range, v.items);
 }
 
 void draw_asteroid(Asteroid *a) {
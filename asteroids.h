@@ -1,9 +1,18 @@
+#pragma once
+
 #include "include/raylib.h"
+#include "jobs.h"
 #include "polar.h"
+#include "rng.h"
+#include "vector.h"
 #include "stdlib.h"
 #include <assert.h>
 #include <string.h>
 
+#define MAX_ASTEROID_VERTICES 8
+
+// The shape is shared between asteroids, only the transformed vertices are
+// per asteroid and they are stored inline, so an asteroid is a plain value.
 typedef struct {
     Vector2 center;
     float rotation_speed;
@@ -12,28 +21,23 @@ typedef struct {
     float angle;
     float max_radius;    
     int coords_size;
-    PolarCoords* coords;
-    Vector2* vector_coords;
+    const PolarCoords* coords;
+    Vector2 vector_coords[MAX_ASTEROID_VERTICES];
 } Asteroid;
 
-typedef Asteroid** AsteroidsVector;
-
-Asteroid* init_asteroid(float x, float y, float direction);
-
-void move_asteroid(Asteroid *a);
+// Asteroids are stored by value, contiguous in update order.
+DEFINE_VECTOR(AsteroidsVector, Asteroid, asteroids_vector)
 
-void free_asteroid(Asteroid *a);
+Asteroid init_asteroid(Rng *rng, float x, float y, float direction);
 
-AsteroidsVector make_asteroids_vector(int size);
+// Points an asteroid read back from a file at the shared shape again.
+void restore_asteroid_shape(Asteroid *a);
 
-int asteroids_vector_len(AsteroidsVector v);
-
-int asteroids_vector_cap(AsteroidsVector v);
-
-void append_to_asteroids_vector(AsteroidsVector v, Asteroid *a);
-
-void delete_from_asteroids_vector(AsteroidsVector v, int idx);
+void move_asteroid(Asteroid *a);
 
-void free_asteroid_vector(AsteroidsVector a);
+// Integrates every asteroid of the vector, ranges of asteroids are spread
+// over the job system. Each asteroid only touches its own state, so the
+// result is the same as calling move_asteroid on each one in order.
+void move_asteroids(JobSystem *js, AsteroidsVector v);
 
 void draw_asteroid(Asteroid *a);
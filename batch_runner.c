@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "alloc.h"
+#include "histogram.h"
+#include "jobs.h"
+#include "sampler.h"
+#include "timing.h"
+#include "trace.h"
+#include "world.h"
+
+// Plays many headless games at once with a random bot at the controls, for
+// bot evaluation and regression runs. Worlds are stepped in lockstep: every
+// tick all of them advance once, in batches spread over the job system.
+
+#define WORLDS_PER_JOB 16
+
+typedef struct {
+    Rng rng;
+    WorldInput input; // kept for a few ticks, bots don't change their mind every frame
+    int hold;
+    long games;
+    long score;
+} Bot;
+
+typedef struct {
+    World *worlds;
+    Bot *bots;
+    JobSystem *js;
+} Batch;
+
+static WorldInput bot_input(Bot *b) {
+    if (b->hold-- > 0) {
+	b->input.shots = 0;
+	return b->input;
+    }
+
+    b->hold = random_value(&b->rng, 5, 30);
+    b->input = (WorldInput){
+	.keys = random_value(&b->rng, 0, WORLD_LEFT | WORLD_RIGHT | WORLD_UP),
+	.shots = random_value(&b->rng, 0, 3) == 0,
+    };
+
+    return b->input;
+}
+
+static void step_batch(void *ctx, int begin, int end) {
+    Batch *batch = ctx;
+
+    for (int i = begin; i < end; i++) {
+	World *w = &batch->worlds[i];
+	Bot *b = &batch->bots[i];
+
+	step_world(w, batch->js, bot_input(b));
+
+	if (w->game_over) {
+	    b->games++;
+	    b->score += w->score;
+	    reset_world(w, next_random(&b->rng));
+	}
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: batch_runner [-n worlds] [-t ticks] [-j threads] [-s seed]\n"
+	    "                    [-a max asteroids] [-p max projectiles] [-c spawn chance]\n"
+	    "                    [-T trace.json] [-H report.csv|json] [-I report interval s]\n"
+	    "                    [-S samples.folded]\n");
+}
+
+int main(int argc, char **argv) {
+    int worlds_count = 1000;
+    long ticks = 10000;
+    int threads = 0;
+    uint64_t seed = 1;
+    WorldConfig config = default_world_config();
+    const char *trace_path = NULL;
+    const char *histogram_path = NULL;
+    const char *sample_path = NULL;
+    double report_interval = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:j:s:a:p:c:T:H:I:S:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    worlds_count = atoi(optarg);
+	    break;
+	case 't':
+	    ticks = atol(optarg);
+	    break;
+	case 'j':
+	    threads = atoi(optarg);
+	    break;
+	case 's':
+	    seed = strtoull(optarg, NULL, 10);
+	    break;
+	case 'a':
+	    config.max_asteroids = atoi(optarg);
+	    break;
+	case 'p':
+	    config.max_projectiles = atoi(optarg);
+	    break;
+	case 'c':
+	    config.spawn_chance = atoi(optarg);
+	    break;
+	case 'T':
+	    trace_path = optarg;
+	    break;
+	case 'H':
+	    histogram_path = optarg;
+	    break;
+	case 'I':
+	    report_interval = atof(optarg);
+	    break;
+	case 'S':
+	    sample_path = optarg;
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+
+    if (worlds_count < 1 || ticks < 1 || config.max_asteroids < 1 ||
+	config.max_projectiles < 1 || config.spawn_chance < 1) {
+	usage();
+	return 1;
+    }
+
+    if (trace_path != NULL) {
+	start_tracing(DEFAULT_TRACE_EVENTS);
+    }
+
+    JobSystem *js = init_job_system(threads);
+
+    Batch batch = {
+	.worlds = tracked_malloc(sizeof(World) * worlds_count),
+	.bots = tracked_malloc(sizeof(Bot) * worlds_count),
+	.js = js,
+    };
+    assert(batch.worlds != NULL && batch.bots != NULL && "Can't allocate worlds");
+
+    Rng seeds = {seed};
+    for (int i = 0; i < worlds_count; i++) {
+	batch.bots[i] = (Bot){.rng = {next_random(&seeds)}};
+	init_world(&batch.worlds[i], config, next_random(&seeds));
+    }
+
+    // One sample per lockstep tick of all the worlds.
+    static Histogram tick_times;
+    init_histogram(&tick_times);
+    NamedHistogram histograms[] = {{"batch_tick", &tick_times}};
+    uint64_t report_ns = report_interval * 1e9;
+
+    if (sample_path != NULL && !start_sampler(DEFAULT_SAMPLER_HZ, DEFAULT_SAMPLER_SAMPLES)) {
+	fprintf(stderr, "Can't start the sampler\n");
+	sample_path = NULL;
+    }
+
+    uint64_t start = now_ns();
+    uint64_t next_report = start + report_ns;
+    for (long tick = 0; tick < ticks; tick++) {
+	uint64_t t = trace_begin();
+	uint64_t tick_start = now_ns();
+	parallel_for(js, worlds_count, WORLDS_PER_JOB, step_batch, &batch);
+	uint64_t tick_end = now_ns();
+	record_histogram(&tick_times, tick_end - tick_start);
+	trace_end("tick", t);
+	end_alloc_frame();
+
+	if (histogram_path != NULL && report_ns > 0 && tick_end >= next_report) {
+	    write_histogram_report(histogram_path, histograms, 1);
+	    next_report = tick_end + report_ns;
+	}
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    if (sample_path != NULL && !stop_sampler(sample_path)) {
+	fprintf(stderr, "Can't write samples to %s\n", sample_path);
+    }
+
+    long games = 0;
+    long score = 0;
+    size_t arena_peak_bytes = 0;
+    BudgetStats asteroids = {0};
+    BudgetStats projectiles = {0};
+    CollisionCounters collisions = {0};
+    for (int i = 0; i < worlds_count; i++) {
+	World *w = &batch.worlds[i];
+	add_collision_counters(&collisions, &w->collisions_total);
+	asteroids.refused += w->asteroid_budget.refused;
+	asteroids.dropped += w->asteroid_budget.dropped;
+	asteroids.recycled += w->asteroid_budget.recycled;
+	projectiles.refused += w->projectile_budget.refused;
+	projectiles.dropped += w->projectile_budget.dropped;
+	projectiles.recycled += w->projectile_budget.recycled;
+
+	games += batch.bots[i].games;
+	score += batch.bots[i].score;
+	size_t peak = arena_peak(&batch.worlds[i].frame_arena);
+	arena_peak_bytes = peak > arena_peak_bytes ? peak : arena_peak_bytes;
+	free_world(&batch.worlds[i]);
+    }
+
+    printf("worlds: %d\n", worlds_count);
+    printf("threads: %d\n", job_system_workers(js));
+    printf("ticks: %ld\n", ticks * worlds_count);
+    printf("games: %ld\n", games);
+    printf("mean score: %.2f\n", games > 0 ? (double)score / games : 0.0);
+    printf("seconds: %.3f\n", seconds);
+    printf("ticks/s: %.0f\n", ticks * worlds_count / seconds);
+    printf("games/s: %.2f\n", games / seconds);
+    printf("frame arena peak: %zu bytes\n", arena_peak_bytes);
+    printf("asteroid budget: %ld refused, %ld dropped, %ld recycled\n",
+	   asteroids.refused, asteroids.dropped, asteroids.recycled);
+    printf("projectile budget: %ld refused, %ld dropped, %ld recycled\n",
+	   projectiles.refused, projectiles.dropped, projectiles.recycled);
+    for (int t = 0; t < PAIR_TYPES; t++) {
+	PairCounters *p = &collisions.pairs[t];
+	printf("%s: %.2f pairs, %.2f circle rejects, %.2f point tests, %.4f hits per tick\n",
+	       pair_type_name(t), (double)p->pairs / (ticks * worlds_count),
+	       (double)p->circle_rejects / (ticks * worlds_count),
+	       (double)p->point_tests / (ticks * worlds_count), (double)p->hits / (ticks * worlds_count));
+    }
+
+    tracked_free(batch.worlds);
+    tracked_free(batch.bots);
+    free_job_system(js);
+
+    if (histogram_path != NULL && !write_histogram_report(histogram_path, histograms, 1)) {
+	fprintf(stderr, "Can't write histogram report to %s\n", histogram_path);
+    }
+
+    if (trace_path != NULL) {
+	if (!write_trace(trace_path)) {
+	    fprintf(stderr, "Can't write trace to %s\n", trace_path);
+	}
+	stop_tracing();
+    }
+
+    report_allocs(stderr);
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "asteroids.h"
+#include "bench_common.h"
+#include "collision.h"
+#include "polar.h"
+#include "projectiles.h"
+#include "rng.h"
+#include "ship.h"
+
+// Microbenchmarks of the collision kernels and the asteroid math they depend
+// on. Every kernel runs over seeded fixtures of FIXTURE_SIZE pairs in three
+// placements: overlapping, near misses (bounding circles overlap, shapes
+// mostly don't) and far apart (rejected by the circles). To compare another
+// implementation, add a row to the kernels table.
+
+#define FIXTURE_SIZE 1024
+#define ANCHOR_X 900
+#define ANCHOR_Y 700
+
+typedef enum { OVERLAPPING, NEAR_MISS, FAR, PLACEMENTS } Placement;
+
+static const char *placement_names[PLACEMENTS] = {"overlapping", "near_miss", "far"};
+
+typedef struct {
+    Asteroid asteroids[FIXTURE_SIZE];
+    Asteroid others[FIXTURE_SIZE];
+    Projectile projectiles[FIXTURE_SIZE];
+    Ship ships[FIXTURE_SIZE];
+} Fixture;
+
+static float random_unit(Rng *rng) {
+    return random_value(rng, 0, 1000000) / 1e6f;
+}
+
+static Asteroid random_asteroid(Rng *rng, Vector2 center) {
+    Asteroid a = init_asteroid(rng, center.x, center.y, random_unit(rng) * 2 * PI);
+    a.angle = random_unit(rng) * 2 * PI;
+    for (int i = 0; i < a.coords_size; i++) {
+	a.vector_coords[i] = polar_to_vector(a.coords[i], a.center, a.angle);
+    }
+    return a;
+}
+
+// Distance between two centers as a fraction of the sum of their bounding
+// radii.
+static float placement_distance(Rng *rng, Placement p) {
+    switch (p) {
+    case OVERLAPPING:
+	return random_unit(rng) * 0.5f;
+    case NEAR_MISS:
+	return 0.8f + random_unit(rng) * 0.2f;
+    default:
+	return 1.5f + random_unit(rng) * 1.5f;
+    }
+}
+
+static Vector2 offset(Rng *rng, Placement p, float reach) {
+    float d = placement_distance(rng, p) * reach;
+    float angle = random_unit(rng) * 2 * PI;
+    return (Vector2){ANCHOR_X + cosf(angle) * d, ANCHOR_Y + sinf(angle) * d};
+}
+
+static void init_fixture(Fixture *f, Placement p, uint64_t seed) {
+    Rng rng = {seed};
+    Vector2 anchor = {ANCHOR_X, ANCHOR_Y};
+
+    for (int i = 0; i < FIXTURE_SIZE; i++) {
+	f->asteroids[i] = random_asteroid(&rng, anchor);
+	float r = f->asteroids[i].max_radius;
+
+	f->others[i] = random_asteroid(&rng, offset(&rng, p, 2 * r));
+
+	Projectile probe = make_projectile(anchor, 0);
+	f->projectiles[i] = make_projectile(offset(&rng, p, r + probe.radius), random_unit(&rng) * 2 * PI);
+
+	Ship ship = init_ship(anchor);
+	ship = init_ship(offset(&rng, p, r + ship.max_radius));
+	ship.direction = random_unit(&rng) * 2 * PI;
+	update_ship_vertices(&ship);
+	f->ships[i] = ship;
+    }
+}
+
+static void bench_projectile_asteroid(void *ctx, long iterations) {
+    Fixture *f = ctx;
+    uint64_t hits = 0;
+    for (long i = 0; i < iterations; i++) {
+	int k = i & (FIXTURE_SIZE - 1);
+	hits += check_projectile_asteroid_collision(&f->projectiles[k], &f->asteroids[k], NULL);
+    }
+    bench_sink += hits;
+}
+
+static void bench_ship_asteroid(void *ctx, long iterations) {
+    Fixture *f = ctx;
+    uint64_t hits = 0;
+    for (long i = 0; i < iterations; i++) {
+	int k = i & (FIXTURE_SIZE - 1);
+	hits += check_ship_asteroid_collision(&f->ships[k], &f->asteroids[k], NULL);
+    }
+    bench_sink += hits;
+}
+
+static void bench_two_asteroids(void *ctx, long iterations) {
+    Fixture *f = ctx;
+    uint64_t hits = 0;
+    for (long i = 0; i < iterations; i++) {
+	int k = i & (FIXTURE_SIZE - 1);
+	hits += check_two_asteroids_collision(&f->asteroids[k], &f->others[k], NULL);
+    }
+    bench_sink += hits;
+}
+
+static void bench_polar_to_vector(void *ctx, long iterations) {
+    Fixture *f = ctx;
+    float sum = 0;
+    for (long i = 0; i < iterations; i++) {
+	Asteroid *a = &f->asteroids[i & (FIXTURE_SIZE - 1)];
+	Vector2 v = polar_to_vector(a->coords[i % a->coords_size], a->center, a->angle);
+	sum += v.x + v.y;
+    }
+    bench_sink += (uint64_t)sum;
+}
+
+static void bench_move_asteroid(void *ctx, long iterations) {
+    Fixture *f = ctx;
+    for (long i = 0; i < iterations; i++) {
+	move_asteroid(&f->others[i & (FIXTURE_SIZE - 1)]);
+    }
+    bench_sink += (uint64_t)f->others[0].center.x;
+}
+
+typedef struct {
+    const char *name;
+    BenchFn fn;
+    bool per_placement; // the placement doesn't matter for the others
+} KernelBench;
+
+static const KernelBench kernels[] = {
+    {"projectile_asteroid", bench_projectile_asteroid, true},
+    {"ship_asteroid", bench_ship_asteroid, true},
+    {"two_asteroids", bench_two_asteroids, true},
+    {"polar_to_vector", bench_polar_to_vector, false},
+    {"move_asteroid", bench_move_asteroid, false},
+};
+
+// Share of the fixture pairs that collide, so placements can be checked.
+static void print_hit_rates(Fixture *f, const char *placement) {
+    int hits[3] = {0};
+    for (int i = 0; i < FIXTURE_SIZE; i++) {
+	hits[0] += check_projectile_asteroid_collision(&f->projectiles[i], &f->asteroids[i], NULL);
+	hits[1] += check_ship_asteroid_collision(&f->ships[i], &f->asteroids[i], NULL);
+	hits[2] += check_two_asteroids_collision(&f->asteroids[i], &f->others[i], NULL);
+    }
+    fprintf(stderr, "fixture %s: hit rates projectile %.2f, ship %.2f, asteroids %.2f\n", placement,
+	    (double)hits[0] / FIXTURE_SIZE, (double)hits[1] / FIXTURE_SIZE, (double)hits[2] / FIXTURE_SIZE);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: bench_collision [-s seed] [-r reps] [-w warmup reps] [-m min ms per rep]\n"
+	    "                       [-f name filter] [-c] [-R results dir]\n");
+}
+
+int main(int argc, char **argv) {
+    BenchOptions options = default_bench_options();
+    uint64_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, BENCH_OPTIONS "s:")) != -1) {
+	if (opt == 's') {
+	    seed = strtoull(optarg, NULL, 10);
+	} else if (!parse_bench_option(&options, opt, optarg)) {
+	    usage();
+	    return 1;
+	}
+    }
+
+    Fixture *fixture = malloc(sizeof(Fixture));
+    assert(fixture != NULL && "Can't allocate fixture");
+
+    ResultsFile results = {0};
+    if (options.results_dir[0] != '\0' &&
+	!open_results(&results, options.results_dir, "bench_collision", argc, argv)) {
+	fprintf(stderr, "Can't write results to %s\n", options.results_dir);
+    }
+
+    print_bench_header(&options, stdout);
+
+    for (int p = 0; p < PLACEMENTS; p++) {
+	init_fixture(fixture, p, seed + p);
+	if (!options.csv) {
+	    print_hit_rates(fixture, placement_names[p]);
+	}
+
+	for (int k = 0; k < sizeof(kernels) / sizeof(KernelBench); k++) {
+	    if (!kernels[k].per_placement && p != OVERLAPPING) {
+		continue;
+	    }
+
+	    char name[64];
+	    if (kernels[k].per_placement) {
+		snprintf(name, sizeof(name), "%s/%s", kernels[k].name, placement_names[p]);
+	    } else {
+		snprintf(name, sizeof(name), "%s", kernels[k].name);
+	    }
+	    if (!bench_selected(&options, name)) {
+		continue;
+	    }
+
+	    BenchResult r = run_bench(&options, name, kernels[k].fn, fixture);
+	    print_bench_result(&options, stdout, &r);
+	    write_bench_samples(&results, &r);
+	}
+    }
+
+    free(fixture);
+
+    if (results.f != NULL) {
+	if (close_results(&results)) {
+	    fprintf(stderr, "results written to %s\n", results.path);
+	} else {
+	    fprintf(stderr, "Can't write results to %s\n", results.path);
+	}
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bench_common.h"
+#include "timing.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+// Set by the Makefile.
+#ifndef BUILD_FLAGS
+#define BUILD_FLAGS "unknown"
+#endif
+#ifndef BUILD_COMMIT
+#define BUILD_COMMIT "unknown"
+#endif
+
+#if defined(__clang__)
+#define COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#define COMPILER "gcc " __VERSION__
+#else
+#define COMPILER "unknown"
+#endif
+
+const Phase world_phases[WORLD_PHASES] = {
+    PHASE_INPUT, PHASE_PROJECTILES, PHASE_CULL, PHASE_COLLISION, PHASE_DELETE, PHASE_MOVE, PHASE_SPAWN,
+};
+
+volatile uint64_t bench_sink;
+
+BenchOptions default_bench_options(void) {
+    return (BenchOptions){
+	.warmup = 2,
+	.reps = 10,
+	.min_rep_ns = 20000000,
+	.filter = NULL,
+	.csv = false,
+	.results_dir = DEFAULT_RESULTS_DIR,
+    };
+}
+
+bool parse_bench_option(BenchOptions *o, int opt, const char *arg) {
+    switch (opt) {
+    case 'r':
+	o->reps = atoi(arg);
+	return o->reps > 0 && o->reps <= MAX_BENCH_REPS;
+    case 'w':
+	o->warmup = atoi(arg);
+	return o->warmup >= 0;
+    case 'm':
+	o->min_rep_ns = atof(arg) * 1e6;
+	return o->min_rep_ns > 0;
+    case 'f':
+	o->filter = arg;
+	return true;
+    case 'c':
+	o->csv = true;
+	return true;
+    case 'R':
+	o->results_dir = arg;
+	return true;
+    default:
+	return false;
+    }
+}
+
+bool bench_selected(BenchOptions *o, const char *name) {
+    return o->filter == NULL || strstr(name, o->filter) != NULL;
+}
+
+static uint64_t time_rep(BenchFn fn, void *ctx, long iterations) {
+    uint64_t start = now_ns();
+    fn(ctx, iterations);
+    return now_ns() - start;
+}
+
+BenchResult run_bench(BenchOptions *o, const char *name, BenchFn fn, void *ctx) {
+    // Double the iterations until a repetition is long enough to time.
+    long iterations = 1;
+    while (time_rep(fn, ctx, iterations) < o->min_rep_ns && iterations < (1L << 40)) {
+	iterations *= 2;
+    }
+
+    for (int i = 0; i < o->warmup; i++) {
+	time_rep(fn, ctx, iterations);
+    }
+
+    BenchResult r = {.name = name, .iterations = iterations, .reps = o->reps, .min_ns = INFINITY};
+    double sum = 0;
+    double sum_sq = 0;
+    for (int i = 0; i < o->reps; i++) {
+	double ns = (double)time_rep(fn, ctx, iterations) / iterations;
+	r.rep_ns[i] = ns;
+	sum += ns;
+	sum_sq += ns * ns;
+	r.min_ns = fmin(r.min_ns, ns);
+	r.max_ns = fmax(r.max_ns, ns);
+    }
+
+    r.mean_ns = sum / o->reps;
+    r.stddev_ns = o->reps > 1 ? sqrt(fmax(0, (sum_sq - sum * sum / o->reps) / (o->reps - 1))) : 0;
+    r.ops_per_s = 1e9 / r.mean_ns;
+    return r;
+}
+
+void print_bench_header(BenchOptions *o, FILE *f) {
+    if (o->csv) {
+	fprintf(f, "name,iterations,reps,mean_ns,stddev_ns,min_ns,max_ns,ops_per_s\n");
+    } else {
+	fprintf(f, "%-36s %12s %10s %10s %10s %14s\n", "benchmark", "ns/op", "stddev", "min", "max", "ops/s");
+    }
+}
+
+void print_bench_result(BenchOptions *o, FILE *f, BenchResult *r) {
+    if (o->csv) {
+	fprintf(f, "%s,%ld,%d,%.3f,%.3f,%.3f,%.3f,%.0f\n", r->name, r->iterations, r->reps, r->mean_ns,
+		r->stddev_ns, r->min_ns, r->max_ns, r->ops_per_s);
+    } else {
+	fprintf(f, "%-36s %12.2f %10.2f %10.2f %10.2f %14.0f\n", r->name, r->mean_ns, r->stddev_ns, r->min_ns,
+		r->max_ns, r->ops_per_s);
+    }
+}
+
+static void write_cpu_model(FILE *f) {
+    FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+    if (cpuinfo == NULL) {
+	return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+	char *value = strchr(line, ':');
+	if (strncmp(line, "model name", 10) == 0 && value != NULL) {
+	    fprintf(f, "meta cpu %s", value + 2);
+	    break;
+	}
+    }
+    fclose(cpuinfo);
+}
+
+bool open_results(ResultsFile *r, const char *dir, const char *bench, int argc, char **argv) {
+    r->f = NULL;
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+	return false;
+    }
+
+    time_t now = time(NULL);
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    char date[32];
+    strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &tm);
+
+    snprintf(r->path, sizeof(r->path), "%s/%s-%s-%d.txt", dir, bench, date, (int)getpid());
+    r->f = fopen(r->path, "w");
+    if (r->f == NULL) {
+	return false;
+    }
+
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    fprintf(r->f, "meta bench %s\n", bench);
+    fprintf(r->f, "meta date %s\n", date);
+
+    struct utsname u;
+    if (uname(&u) == 0) {
+	fprintf(r->f, "meta host %s\n", u.nodename);
+	fprintf(r->f, "meta os %s %s %s\n", u.sysname, u.release, u.machine);
+    }
+    write_cpu_model(r->f);
+    fprintf(r->f, "meta cpus %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(r->f, "meta compiler %s\n", COMPILER);
+    fprintf(r->f, "meta flags %s\n", BUILD_FLAGS);
+    fprintf(r->f, "meta commit %s\n", BUILD_COMMIT);
+
+    fprintf(r->f, "meta args");
+    for (int i = 0; i < argc; i++) {
+	fprintf(r->f, " %s", argv[i]);
+    }
+    fprintf(r->f, "\n");
+    return true;
+}
+
+void write_result_sample(ResultsFile *r, const char *name, double ns) {
+    if (r->f != NULL) {
+	fprintf(r->f, "sample %s %.3f\n", name, ns);
+    }
+}
+
+void write_bench_samples(ResultsFile *r, BenchResult *b) {
+    for (int i = 0; i < b->reps; i++) {
+	write_result_sample(r, b->name, b->rep_ns[i]);
+    }
+}
+
+bool close_results(ResultsFile *r) {
+    if (r->f == NULL) {
+	return true;
+    }
+
+    bool ok = fclose(r->f) == 0;
+    r->f = NULL;
+    return ok;
+}
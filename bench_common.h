@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "profiler.h"
+
+// Small benchmark harness shared by the bench_* programs. A benchmark runs
+// its operation a given number of times; the harness calibrates that number
+// so one repetition takes at least min_rep_ns, runs warmup repetitions, then
+// measures reps repetitions and reports per-operation statistics.
+
+typedef void (*BenchFn)(void *ctx, long iterations);
+
+#define MAX_BENCH_REPS 1000
+#define WORLD_PHASES 7
+#define DEFAULT_RESULTS_DIR "bench_results"
+
+typedef struct {
+    int warmup;
+    int reps;
+    uint64_t min_rep_ns;
+    const char *filter; // only benchmarks whose name contains it, NULL for all
+    bool csv;
+    const char *results_dir; // empty for no results file
+} BenchOptions;
+
+typedef struct {
+    const char *name;
+    long iterations; // per repetition
+    int reps;
+    double mean_ns;  // per operation
+    double stddev_ns;
+    double min_ns;
+    double max_ns;
+    double ops_per_s;
+    double rep_ns[MAX_BENCH_REPS]; // per operation, of every repetition
+} BenchResult;
+
+// Phases timed by step_world, in order.
+extern const Phase world_phases[WORLD_PHASES];
+
+// Results of a benchmark go here so the compiler can't drop the work.
+extern volatile uint64_t bench_sink;
+
+BenchOptions default_bench_options(void);
+
+// Parses -r reps, -w warmup, -m min ms per rep, -f filter, -c (CSV) and
+// -R results dir, and leaves other options to the caller. Returns false on
+// a bad option.
+bool parse_bench_option(BenchOptions *o, int opt, const char *arg);
+
+#define BENCH_OPTIONS "r:w:m:f:cR:"
+
+bool bench_selected(BenchOptions *o, const char *name);
+
+BenchResult run_bench(BenchOptions *o, const char *name, BenchFn fn, void *ctx);
+
+void print_bench_header(BenchOptions *o, FILE *f);
+
+void print_bench_result(BenchOptions *o, FILE *f, BenchResult *r);
+
+// Every run of a benchmark program writes its samples to a new text file in
+// the results directory, <bench>-<UTC time>-<pid>.txt, for bench_compare.
+// The file starts with "meta <key> <value>" lines describing the machine,
+// compiler and command line, followed by one "sample <name> <ns>" line per
+// measured repetition.
+typedef struct {
+    FILE *f;
+    char path[512];
+} ResultsFile;
+
+// Creates dir if needed. Returns false, with r->f NULL, when the file can't
+// be created.
+bool open_results(ResultsFile *r, const char *dir, const char *bench, int argc, char **argv);
+
+void write_result_sample(ResultsFile *r, const char *name, double ns);
+
+void write_bench_samples(ResultsFile *r, BenchResult *b);
+
+bool close_results(ResultsFile *r);
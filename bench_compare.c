@@ -0,0 +1,299 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "vector.h"
+
+// Compares two results files written by the bench_* programs, a stored
+// baseline and a new run. Every sample name found in both is tested with a
+// one-sided Mann-Whitney U test over its samples; a name regressed when its
+// median grew by more than the threshold and the test says it's unlikely to
+// be noise. Exits with 1 when anything regressed.
+
+#define MAX_META 16
+#define MAX_NAME 320
+
+DEFINE_VECTOR(DoubleVector, double, double_vector)
+
+typedef struct {
+    char name[MAX_NAME];
+    DoubleVector samples;
+} Series;
+
+DEFINE_VECTOR(SeriesVector, Series, series_vector)
+
+typedef struct {
+    const char *path;
+    char meta[MAX_META][2][256]; // key, value
+    int meta_len;
+    SeriesVector series;
+} Results;
+
+static Series *find_series(Results *r, const char *name) {
+    for (int i = 0; i < series_vector_len(r->series); i++) {
+	if (strcmp(r->series.items[i].name, name) == 0) {
+	    return &r->series.items[i];
+	}
+    }
+    return NULL;
+}
+
+static const char *find_meta(Results *r, const char *key) {
+    for (int i = 0; i < r->meta_len; i++) {
+	if (strcmp(r->meta[i][0], key) == 0) {
+	    return r->meta[i][1];
+	}
+    }
+    return "?";
+}
+
+static bool read_results(const char *path, Results *r) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+	return false;
+    }
+
+    r->path = path;
+    r->meta_len = 0;
+    r->series = make_series_vector(64);
+
+    char line[1024];
+    char name[MAX_NAME];
+    while (fgets(line, sizeof(line), f) != NULL) {
+	line[strcspn(line, "\n")] = '\0';
+
+	double value;
+	int key_len;
+	if (strncmp(line, "meta ", 5) == 0 && r->meta_len < MAX_META) {
+	    key_len = strcspn(line + 5, " ");
+	    snprintf(r->meta[r->meta_len][0], sizeof(r->meta[0][0]), "%.*s", key_len, line + 5);
+	    snprintf(r->meta[r->meta_len][1], sizeof(r->meta[0][1]), "%s",
+		     line[5 + key_len] == ' ' ? line + 6 + key_len : "");
+	    r->meta_len++;
+	} else if (sscanf(line, "sample %319s %lf", name, &value) == 2) {
+	    Series *s = find_series(r, name);
+	    if (s == NULL) {
+		Series created = {.samples = make_double_vector(16)};
+		snprintf(created.name, sizeof(created.name), "%s", name);
+		append_to_series_vector(&r->series, created);
+		s = &r->series.items[series_vector_len(r->series) - 1];
+	    }
+	    append_to_double_vector(&s->samples, value);
+	}
+    }
+
+    fclose(f);
+    return true;
+}
+
+static void free_results(Results *r) {
+    for (int i = 0; i < series_vector_len(r->series); i++) {
+	free_double_vector(&r->series.items[i].samples);
+    }
+    free_series_vector(&r->series);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(DoubleVector v) {
+    double *sorted = tracked_malloc(sizeof(double) * v.len);
+    assert(sorted != NULL && "Can't allocate samples");
+    memcpy(sorted, v.items, sizeof(double) * v.len);
+    qsort(sorted, v.len, sizeof(double), compare_doubles);
+
+    double m = v.len % 2 == 1 ? sorted[v.len / 2] : (sorted[v.len / 2 - 1] + sorted[v.len / 2]) / 2;
+    tracked_free(sorted);
+    return m;
+}
+
+typedef struct {
+    double value;
+    bool is_new;
+} Ranked;
+
+static int compare_ranked(const void *a, const void *b) {
+    return compare_doubles(&((const Ranked *)a)->value, &((const Ranked *)b)->value);
+}
+
+// Probability of seeing the new samples rank this high (slower == true) or
+// this low if both sets came from the same distribution. Normal
+// approximation with tie correction, good from about 8 samples per side.
+static double mann_whitney_p(DoubleVector base, DoubleVector new, bool slower) {
+    int n1 = base.len;
+    int n2 = new.len;
+    int n = n1 + n2;
+
+    Ranked *all = tracked_malloc(sizeof(Ranked) * n);
+    assert(all != NULL && "Can't allocate samples");
+    for (int i = 0; i < n1; i++) {
+	all[i] = (Ranked){base.items[i], false};
+    }
+    for (int i = 0; i < n2; i++) {
+	all[n1 + i] = (Ranked){new.items[i], true};
+    }
+    qsort(all, n, sizeof(Ranked), compare_ranked);
+
+    // Tied values share the average of their ranks.
+    double new_ranks = 0;
+    double ties = 0;
+    for (int i = 0; i < n;) {
+	int j = i;
+	while (j < n && all[j].value == all[i].value) {
+	    j++;
+	}
+	double rank = (i + 1 + j) / 2.0;
+	for (int k = i; k < j; k++) {
+	    new_ranks += all[k].is_new ? rank : 0;
+	}
+	double t = j - i;
+	ties += t * t * t - t;
+	i = j;
+    }
+    tracked_free(all);
+
+    double u = new_ranks - n2 * (n2 + 1) / 2.0;
+    double mean = n1 * (double)n2 / 2;
+    double variance = n1 * (double)n2 / 12 * ((n + 1) - ties / ((double)n * (n - 1)));
+    if (variance <= 0) {
+	return 1;
+    }
+
+    double z = slower ? (u - mean - 0.5) / sqrt(variance) : (mean - u - 0.5) / sqrt(variance);
+    return 0.5 * erfc(z / sqrt(2));
+}
+
+static void format_ns(char *buffer, size_t size, double ns) {
+    if (ns >= 1e9) {
+	snprintf(buffer, size, "%.3f s", ns / 1e9);
+    } else if (ns >= 1e6) {
+	snprintf(buffer, size, "%.3f ms", ns / 1e6);
+    } else if (ns >= 1e3) {
+	snprintf(buffer, size, "%.3f us", ns / 1e3);
+    } else {
+	snprintf(buffer, size, "%.2f ns", ns);
+    }
+}
+
+static void print_meta(const char *label, Results *r) {
+    printf("%-8s %s\n", label, r->path);
+    printf("         %s, commit %s, %s, %s\n", find_meta(r, "date"), find_meta(r, "commit"),
+	   find_meta(r, "compiler"), find_meta(r, "cpu"));
+}
+
+// Results of different machines or builds aren't comparable, say so.
+static void print_meta_changes(Results *base, Results *new) {
+    static const char *keys[] = {"bench", "host", "os", "cpu", "cpus", "compiler", "flags", "commit", "args"};
+    for (int i = 0; i < (int)(sizeof(keys) / sizeof(keys[0])); i++) {
+	const char *from = find_meta(base, keys[i]);
+	const char *to = find_meta(new, keys[i]);
+	if (strcmp(from, to) != 0) {
+	    printf("  %s: %s -> %s\n", keys[i], from, to);
+	}
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: bench_compare [-t threshold %%] [-a alpha] [-q] baseline.txt new.txt\n");
+}
+
+int main(int argc, char **argv) {
+    double threshold = 5;
+    double alpha = 0.01;
+    bool quiet = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:a:q")) != -1) {
+	switch (opt) {
+	case 't':
+	    threshold = atof(optarg);
+	    break;
+	case 'a':
+	    alpha = atof(optarg);
+	    break;
+	case 'q':
+	    quiet = true;
+	    break;
+	default:
+	    usage();
+	    return 2;
+	}
+    }
+
+    if (argc - optind != 2 || !(threshold >= 0) || !(alpha > 0 && alpha < 1)) {
+	usage();
+	return 2;
+    }
+
+    Results base;
+    Results new;
+    if (!read_results(argv[optind], &base)) {
+	fprintf(stderr, "Can't read %s\n", argv[optind]);
+	return 2;
+    }
+    if (!read_results(argv[optind + 1], &new)) {
+	fprintf(stderr, "Can't read %s\n", argv[optind + 1]);
+	free_results(&base);
+	return 2;
+    }
+
+    print_meta("baseline", &base);
+    print_meta("new", &new);
+    print_meta_changes(&base, &new);
+    printf("\n%-44s %12s %12s %9s %9s\n", "name", "baseline", "new", "change", "p");
+
+    int regressions = 0;
+    int improvements = 0;
+    int unchanged = 0;
+    for (int i = 0; i < series_vector_len(base.series); i++) {
+	Series *b = &base.series.items[i];
+	Series *n = find_series(&new, b->name);
+	if (n == NULL) {
+	    printf("%-44s only in the baseline\n", b->name);
+	    continue;
+	}
+
+	double from = median(b->samples);
+	double to = median(n->samples);
+	double change = from > 0 ? (to / from - 1) * 100 : 0;
+	bool slower = to >= from;
+	double p = mann_whitney_p(b->samples, n->samples, slower);
+
+	const char *verdict = "";
+	if (p < alpha && fabs(change) > threshold) {
+	    verdict = slower ? "REGRESSION" : "faster";
+	    regressions += slower;
+	    improvements += !slower;
+	} else {
+	    unchanged++;
+	    if (quiet) {
+		continue;
+	    }
+	}
+
+	char from_text[32];
+	char to_text[32];
+	format_ns(from_text, sizeof(from_text), from);
+	format_ns(to_text, sizeof(to_text), to);
+	printf("%-44s %12s %12s %+8.1f%% %9.4f  %s\n", b->name, from_text, to_text, change, p, verdict);
+    }
+
+    for (int i = 0; i < series_vector_len(new.series); i++) {
+	if (find_series(&base, new.series.items[i].name) == NULL) {
+	    printf("%-44s only in the new run\n", new.series.items[i].name);
+	}
+    }
+
+    printf("\n%d regressed, %d faster, %d unchanged (threshold %.1f%% on the median, alpha %g)\n",
+	   regressions, improvements, unchanged, threshold, alpha);
+
+    free_results(&base);
+    free_results(&new);
+    return regressions > 0 ? 1 : 0;
+}
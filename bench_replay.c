@@ -0,0 +1,331 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench_common.h"
+#include "histogram.h"
+#include "jobs.h"
+#include "recorder.h"
+#include "session.h"
+#include "timing.h"
+#include "world.h"
+
+// End-to-end benchmark on recorded games. Every session given on the command
+// line is replayed headless a few times; each replay is timed as a whole and
+// per tick, and must end in the recorded state, so a faster build is also
+// shown to play the same games. Record sessions with ASTEROIDS_SESSION=dir.
+//
+// Flight recorder dumps (ASTEROIDS_FLIGHT=dir) are replayed the same way from
+// their keyframe: the recorded ticks around a spike are stepped again and the
+// entity counts of every tick must match the recording.
+
+typedef struct {
+    const char *path;
+    long ticks;
+    int reps;
+    double mean_ms; // per replay
+    double min_ms;
+    uint64_t tick_p50_ns; // over the ticks of every replay
+    uint64_t tick_p99_ns;
+    uint64_t tick_max_ns;
+    bool verified;
+} ReplayResult;
+
+// Plays the session once, returns false when the game ends differently.
+// phase_ns gets the time of every phase over the whole replay.
+static bool replay_session(Session *s, JobSystem *js, World *w, Histogram *ticks, uint64_t *ns,
+			   uint64_t phase_ns[WORLD_PHASES]) {
+    reset_world(w, s->seed);
+    for (int p = 0; p < WORLD_PHASES; p++) {
+	phase_ns[p] = 0;
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < world_input_vector_len(s->inputs); i++) {
+	uint64_t tick_start = now_ns();
+	step_world(w, js, s->inputs.items[i]);
+	record_histogram(ticks, now_ns() - tick_start);
+
+	uint64_t phases[PHASES];
+	end_profiler_frame(w->profiler);
+	last_frame_phases(w->profiler, phases);
+	for (int p = 0; p < WORLD_PHASES; p++) {
+	    phase_ns[p] += phases[world_phases[p]];
+	}
+    }
+    *ns = now_ns() - start;
+
+    SessionEnd end = session_end(w);
+    return end.tick == s->end.tick && end.score == s->end.score &&
+	end.game_over == s->end.game_over && end.digest == s->end.digest;
+}
+
+// Plays the ticked frames of a flight dump from its keyframe. Returns the
+// number of ticks that don't match the recorded tick or entity counts.
+static long replay_flight(FlightDump *d, JobSystem *js, World *w, Histogram *ticks, uint64_t *ns,
+			  uint64_t phase_ns[WORLD_PHASES]) {
+    restore_world_snapshot(w, &d->keyframe);
+    for (int p = 0; p < WORLD_PHASES; p++) {
+	phase_ns[p] = 0;
+    }
+
+    long mismatches = 0;
+    uint64_t start = now_ns();
+    for (long i = 0; i < d->count; i++) {
+	FrameRecord *frame = &d->frames[i];
+	if (!frame->ticked) {
+	    continue;
+	}
+	if (w->tick != frame->tick) {
+	    mismatches++;
+	    continue;
+	}
+
+	uint64_t tick_start = now_ns();
+	step_world(w, js, frame->input);
+	record_histogram(ticks, now_ns() - tick_start);
+
+	uint64_t phases[PHASES];
+	end_profiler_frame(w->profiler);
+	last_frame_phases(w->profiler, phases);
+	for (int p = 0; p < WORLD_PHASES; p++) {
+	    phase_ns[p] += phases[world_phases[p]];
+	}
+
+	if (w->asteroids.len != frame->asteroids || w->projectiles.len != frame->projectiles) {
+	    mismatches++;
+	}
+    }
+    *ns = now_ns() - start;
+    return mismatches;
+}
+
+static void print_mismatch(Session *s, World *w) {
+    SessionEnd end = session_end(w);
+    fprintf(stderr, "  recorded: tick %ld, score %d, %s, digest %016llx\n", s->end.tick, s->end.score,
+	    s->end.game_over ? "game over" : "playing", (unsigned long long)s->end.digest);
+    fprintf(stderr, "  replayed: tick %ld, score %d, %s, digest %016llx\n", end.tick, end.score,
+	    end.game_over ? "game over" : "playing", (unsigned long long)end.digest);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: bench_replay [-r reps] [-j threads] [-c] [-R results dir] "
+	    "session.bin|flight-N.bin...\n");
+}
+
+static void print_result(ReplayResult *r, bool csv) {
+    if (csv) {
+	printf("%s,%ld,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%d\n", r->path, r->ticks, r->reps, r->mean_ms, r->min_ms,
+	       r->tick_p50_ns / 1e3, r->tick_p99_ns / 1e3, r->tick_max_ns / 1e3, r->verified);
+    } else {
+	printf("%-40s %8ld %10.3f %10.3f %10.3f %10.3f %10.3f  %s\n", r->path, r->ticks, r->mean_ms, r->min_ms,
+	       r->tick_p50_ns / 1e3, r->tick_p99_ns / 1e3, r->tick_max_ns / 1e3, r->verified ? "ok" : "MISMATCH");
+    }
+}
+
+// Samples are named <kind>/<file name>/total and <kind>/<file name>/<phase>.
+static void sample_names(const char *kind, const char *file, char total[320], char phases[WORLD_PHASES][320]) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s", file);
+    const char *name = basename(path);
+    snprintf(total, 320, "%s/%s/total", kind, name);
+    for (int p = 0; p < WORLD_PHASES; p++) {
+	snprintf(phases[p], 320, "%s/%s/%s", kind, name, phase_name(world_phases[p]));
+    }
+}
+
+// A dump without a keyframe was taken when the world hadn't ticked for the
+// whole ring, there is nothing to replay; only its recorded timings are shown.
+static bool bench_flight_dump(const char *path, FlightDump *d, JobSystem *js, Profiler *profiler, Histogram *ticks,
+			      int reps, bool csv, ResultsFile *results) {
+    if (!d->has_keyframe) {
+	uint64_t slowest = 0;
+	long slowest_frame = -1;
+	for (long i = 0; i < d->count; i++) {
+	    if (d->frames[i].frame_ns > slowest) {
+		slowest = d->frames[i].frame_ns;
+		slowest_frame = d->frames[i].frame;
+	    }
+	}
+	fprintf(stderr, "%s: no keyframe, nothing to replay; %ld frames, slowest %.3f ms at frame %ld\n", path,
+		d->count, slowest / 1e6, slowest_frame);
+	return true;
+    }
+
+    World w;
+    init_world(&w, d->keyframe.state.config, 0);
+    w.profiler = profiler;
+    init_histogram(ticks);
+
+    char total_name[320];
+    char phase_names[WORLD_PHASES][320];
+    sample_names("flight", path, total_name, phase_names);
+
+    ReplayResult r = {
+	.path = path,
+	.reps = reps,
+	.verified = true,
+    };
+    for (long i = 0; i < d->count; i++) {
+	r.ticks += d->frames[i].ticked;
+    }
+    uint64_t total_ns = 0;
+    uint64_t min_ns = UINT64_MAX;
+    for (int rep = 0; rep < reps; rep++) {
+	uint64_t ns;
+	uint64_t phase_ns[WORLD_PHASES];
+	long mismatches = replay_flight(d, js, &w, ticks, &ns, phase_ns);
+	if (mismatches > 0) {
+	    if (r.verified) {
+		fprintf(stderr, "%s: replay %d doesn't match the recording in %ld of %ld ticks\n", path, rep,
+			mismatches, r.ticks);
+	    }
+	    r.verified = false;
+	}
+	total_ns += ns;
+	min_ns = ns < min_ns ? ns : min_ns;
+
+	write_result_sample(results, total_name, ns);
+	for (int p = 0; p < WORLD_PHASES; p++) {
+	    write_result_sample(results, phase_names[p], phase_ns[p]);
+	}
+    }
+
+    r.mean_ms = total_ns / 1e6 / reps;
+    r.min_ms = min_ns / 1e6;
+    r.tick_p50_ns = histogram_percentile(ticks, 50);
+    r.tick_p99_ns = histogram_percentile(ticks, 99);
+    r.tick_max_ns = ticks->max;
+    print_result(&r, csv);
+
+    free_world(&w);
+    return r.verified;
+}
+
+int main(int argc, char **argv) {
+    int reps = 10;
+    int threads = 0;
+    bool csv = false;
+    const char *results_dir = DEFAULT_RESULTS_DIR;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:j:cR:")) != -1) {
+	switch (opt) {
+	case 'r':
+	    reps = atoi(optarg);
+	    break;
+	case 'j':
+	    threads = atoi(optarg);
+	    break;
+	case 'c':
+	    csv = true;
+	    break;
+	case 'R':
+	    results_dir = optarg;
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+
+    if (reps < 1 || optind >= argc) {
+	usage();
+	return 1;
+    }
+
+    ResultsFile results = {0};
+    if (results_dir[0] != '\0' && !open_results(&results, results_dir, "bench_replay", argc, argv)) {
+	fprintf(stderr, "Can't write results to %s\n", results_dir);
+    }
+
+    JobSystem *js = init_job_system(threads);
+
+    if (csv) {
+	printf("session,ticks,reps,mean_ms,min_ms,tick_p50_us,tick_p99_us,tick_max_us,verified\n");
+    } else {
+	printf("%-40s %8s %10s %10s %10s %10s %10s  %s\n", "session", "ticks", "mean ms", "min ms",
+	       "p50 us", "p99 us", "max us", "state");
+    }
+
+    static Histogram ticks;
+    static Profiler profiler;
+    init_profiler(&profiler);
+    int failed = 0;
+    for (int i = optind; i < argc; i++) {
+	FlightDump d;
+	if (read_flight_dump(argv[i], &d)) {
+	    failed += !bench_flight_dump(argv[i], &d, js, &profiler, &ticks, reps, csv, &results);
+	    free_flight_dump(&d);
+	    continue;
+	}
+
+	Session s;
+	if (!read_session(argv[i], &s)) {
+	    fprintf(stderr, "Can't read session or flight dump %s\n", argv[i]);
+	    failed++;
+	    continue;
+	}
+
+	World w;
+	init_world(&w, s.config, s.seed);
+	w.profiler = &profiler;
+	init_histogram(&ticks);
+
+	char total_name[320];
+	char phase_names[WORLD_PHASES][320];
+	sample_names("replay", argv[i], total_name, phase_names);
+
+	ReplayResult r = {
+	    .path = argv[i],
+	    .ticks = world_input_vector_len(s.inputs),
+	    .reps = reps,
+	    .verified = true,
+	};
+	uint64_t total_ns = 0;
+	uint64_t min_ns = UINT64_MAX;
+	for (int rep = 0; rep < reps; rep++) {
+	    uint64_t ns;
+	    uint64_t phase_ns[WORLD_PHASES];
+	    if (!replay_session(&s, js, &w, &ticks, &ns, phase_ns)) {
+		if (r.verified) {
+		    fprintf(stderr, "%s: replay %d doesn't match the recording\n", argv[i], rep);
+		    print_mismatch(&s, &w);
+		}
+		r.verified = false;
+	    }
+	    total_ns += ns;
+	    min_ns = ns < min_ns ? ns : min_ns;
+
+	    write_result_sample(&results, total_name, ns);
+	    for (int p = 0; p < WORLD_PHASES; p++) {
+		write_result_sample(&results, phase_names[p], phase_ns[p]);
+	    }
+	}
+
+	r.mean_ms = total_ns / 1e6 / reps;
+	r.min_ms = min_ns / 1e6;
+	r.tick_p50_ns = histogram_percentile(&ticks, 50);
+	r.tick_p99_ns = histogram_percentile(&ticks, 99);
+	r.tick_max_ns = ticks.max;
+	print_result(&r, csv);
+
+	failed += !r.verified;
+	free_world(&w);
+	free_session(&s);
+    }
+
+    free_job_system(js);
+
+    if (results.f != NULL) {
+	if (close_results(&results)) {
+	    fprintf(stderr, "results written to %s\n", results.path);
+	} else {
+	    fprintf(stderr, "Can't write results to %s\n", results.path);
+	}
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,344 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "bench_common.h"
+#include "histogram.h"
+#include "jobs.h"
+#include "timing.h"
+#include "world.h"
+
+// Stress benchmark of one world with a growing number of asteroids. For every
+// count the world is sized to keep the density constant, filled with
+// asteroids and stepped for a fixed number of ticks while the ship turns and
+// fires. Asteroids that were destroyed or left the world are replaced
+// between ticks, and a ship hit doesn't end the game, so every tick does the
+// work of the full count.
+
+#define MAX_COUNTS 32
+#define SHIP_CLEARANCE 200 // no asteroid is placed this close to the ship
+
+typedef struct {
+    int asteroids;
+    int width;
+    int height;
+    long ticks;
+    double seconds; // in step_world
+    uint64_t tick_p50_ns;
+    uint64_t tick_p99_ns;
+    uint64_t tick_max_ns;
+    uint64_t phase_ns[WORLD_PHASES]; // summed over the ticks
+    long ship_hits;
+    long replaced; // asteroids put back between ticks
+    size_t entity_bytes;
+    size_t arena_peak_bytes;
+    long max_rss_kb; // of the process so far, counts only grow
+    CollisionCounters collisions;
+} ScalingResult;
+
+typedef struct {
+    long ticks;
+    double density; // asteroids per million square pixels
+    double fire_rate; // shots per tick
+    uint64_t seed;
+} ScalingOptions;
+
+static Asteroid random_asteroid(Rng *rng, World *w) {
+    Vector2 ship = w->ship.center;
+    for (;;) {
+	float x = random_value(rng, 0, w->config.width);
+	float y = random_value(rng, 0, w->config.height);
+	if (hypotf(x - ship.x, y - ship.y) >= SHIP_CLEARANCE) {
+	    return init_asteroid(rng, x, y, random_value(rng, 0, 359) * DEG2RAD);
+	}
+    }
+}
+
+// Grids of detect_collisions cover the world in cells of twice the asteroid
+// radius, two of them per tick, plus a few arrays per entity.
+static size_t scaling_arena_size(WorldConfig c) {
+    size_t cells = (size_t)(c.width / 100 + 2) * (c.height / 100 + 2);
+    size_t entities = (size_t)c.max_asteroids + c.max_projectiles;
+    return (1 << 20) + cells * 2 * sizeof(int) + entities * 64;
+}
+
+// Every tick is a sample of the tick and of its phases.
+static ScalingResult run_scaling(JobSystem *js, ScalingOptions *o, int count, ResultsFile *results) {
+    // Keeps the aspect ratio of the default screen.
+    WorldConfig config = default_world_config();
+    double area = count / o->density * 1e6;
+    double aspect = (double)config.width / config.height;
+    config.width = fmax(sqrt(area * aspect), 1000);
+    config.height = fmax(sqrt(area / aspect), 1000);
+    config.max_asteroids = count;
+    config.spawn_chance = 1;
+    config.frame_arena_size = scaling_arena_size(config);
+
+    static Profiler profiler;
+    init_profiler(&profiler);
+
+    World w;
+    init_world(&w, config, o->seed);
+    w.profiler = &profiler;
+
+    Rng rng = {o->seed};
+    ScalingResult r = {
+	.asteroids = count,
+	.width = config.width,
+	.height = config.height,
+	.ticks = o->ticks,
+	.entity_bytes = sizeof(Asteroid) * count + sizeof(Projectile) * config.max_projectiles,
+    };
+
+    static Histogram tick_times;
+    init_histogram(&tick_times);
+
+    char tick_name[64];
+    char phase_names[WORLD_PHASES][64];
+    snprintf(tick_name, sizeof(tick_name), "scaling/%d/tick", count);
+    for (int p = 0; p < WORLD_PHASES; p++) {
+	snprintf(phase_names[p], sizeof(phase_names[p]), "scaling/%d/%s", count, phase_name(world_phases[p]));
+    }
+
+    double shots = 0;
+    uint64_t total_ns = 0;
+    for (long tick = 0; tick < o->ticks; tick++) {
+	while (asteroids_vector_len(w.asteroids) < count) {
+	    try_append_to_asteroids_vector(&w.asteroids, random_asteroid(&rng, &w));
+	    if (tick > 0) {
+		r.replaced++;
+	    }
+	}
+
+	shots += o->fire_rate;
+	WorldInput input = {.keys = WORLD_LEFT, .shots = fmin(shots, MAX_SHOTS_PER_TICK)};
+	shots -= input.shots;
+
+	uint64_t start = now_ns();
+	step_world(&w, js, input);
+	uint64_t ns = now_ns() - start;
+
+	total_ns += ns;
+	record_histogram(&tick_times, ns);
+	write_result_sample(results, tick_name, ns);
+
+	uint64_t phases[PHASES];
+	end_profiler_frame(&profiler);
+	last_frame_phases(&profiler, phases);
+	for (int p = 0; p < WORLD_PHASES; p++) {
+	    r.phase_ns[p] += phases[world_phases[p]];
+	    write_result_sample(results, phase_names[p], phases[world_phases[p]]);
+	}
+
+	if (w.game_over) {
+	    r.ship_hits++;
+	    w.game_over = false;
+	}
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    r.seconds = total_ns / 1e9;
+    r.tick_p50_ns = histogram_percentile(&tick_times, 50);
+    r.tick_p99_ns = histogram_percentile(&tick_times, 99);
+    r.tick_max_ns = tick_times.max;
+    r.arena_peak_bytes = arena_peak(&w.frame_arena);
+    r.max_rss_kb = usage.ru_maxrss;
+    r.collisions = w.collisions_total;
+
+    free_world(&w);
+    return r;
+}
+
+static void print_result(ScalingResult *r) {
+    printf("%9d asteroids, %6dx%-6d %10.1f ticks/s, p50 %9.3f ms, p99 %9.3f ms, %7ld ship hits, %8zu KiB arena, %8ld KiB rss\n",
+	   r->asteroids, r->width, r->height, r->ticks / r->seconds, r->tick_p50_ns / 1e6,
+	   r->tick_p99_ns / 1e6, r->ship_hits, r->arena_peak_bytes >> 10, r->max_rss_kb);
+
+    printf("          ");
+    for (int p = 0; p < WORLD_PHASES; p++) {
+	printf(" %s %.3f", phase_name(world_phases[p]), r->phase_ns[p] / 1e6 / r->ticks);
+    }
+    printf(" ms/tick\n");
+
+    for (int t = 0; t < PAIR_TYPES; t++) {
+	PairCounters *p = &r->collisions.pairs[t];
+	printf("           %s: %.1f pairs, %.1f point tests, %.2f hits per tick\n", pair_type_name(t),
+	       (double)p->pairs / r->ticks, (double)p->point_tests / r->ticks, (double)p->hits / r->ticks);
+    }
+}
+
+// One row or object per asteroid count. Phase and collision columns are per
+// tick. The file is JSON when path ends in .json, CSV otherwise.
+static bool write_results(const char *path, ScalingOptions *o, ScalingResult *rs, int count) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+	return false;
+    }
+
+    size_t len = strlen(path);
+    bool json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+
+    if (json) {
+	fprintf(f, "{\n  \"ticks\": %ld, \"density\": %g, \"fire_rate\": %g, \"seed\": %llu,\n  \"results\": [\n",
+		o->ticks, o->density, o->fire_rate, (unsigned long long)o->seed);
+    } else {
+	fprintf(f, "asteroids,width,height,ticks,ticks_per_s,tick_p50_us,tick_p99_us,tick_max_us");
+	for (int p = 0; p < WORLD_PHASES; p++) {
+	    fprintf(f, ",%s_us", phase_name(world_phases[p]));
+	}
+	for (int t = 0; t < PAIR_TYPES; t++) {
+	    fprintf(f, ",%s_pairs,%s_point_tests,%s_hits", pair_type_name(t), pair_type_name(t), pair_type_name(t));
+	}
+	fprintf(f, ",ship_hits,replaced,entity_bytes,arena_peak_bytes,max_rss_kb\n");
+    }
+
+    for (int i = 0; i < count; i++) {
+	ScalingResult *r = &rs[i];
+	double ticks = r->ticks;
+
+	if (json) {
+	    fprintf(f, "    {\"asteroids\": %d, \"width\": %d, \"height\": %d, \"ticks\": %ld, \"ticks_per_s\": %.3f, "
+		    "\"tick_p50_us\": %.3f, \"tick_p99_us\": %.3f, \"tick_max_us\": %.3f,\n     \"phases_us\": {",
+		    r->asteroids, r->width, r->height, r->ticks, ticks / r->seconds,
+		    r->tick_p50_ns / 1e3, r->tick_p99_ns / 1e3, r->tick_max_ns / 1e3);
+	    for (int p = 0; p < WORLD_PHASES; p++) {
+		fprintf(f, "%s\"%s\": %.3f", p > 0 ? ", " : "", phase_name(world_phases[p]), r->phase_ns[p] / 1e3 / ticks);
+	    }
+	    fprintf(f, "},\n     \"collisions\": {");
+	    for (int t = 0; t < PAIR_TYPES; t++) {
+		PairCounters *p = &r->collisions.pairs[t];
+		fprintf(f, "%s\"%s\": {\"pairs\": %.3f, \"point_tests\": %.3f, \"hits\": %.3f}", t > 0 ? ", " : "",
+			pair_type_name(t), p->pairs / ticks, p->point_tests / ticks, p->hits / ticks);
+	    }
+	    fprintf(f, "},\n     \"ship_hits\": %ld, \"replaced\": %ld, \"entity_bytes\": %zu, "
+		    "\"arena_peak_bytes\": %zu, \"max_rss_kb\": %ld}%s\n",
+		    r->ship_hits, r->replaced, r->entity_bytes, r->arena_peak_bytes, r->max_rss_kb,
+		    i + 1 < count ? "," : "");
+	} else {
+	    fprintf(f, "%d,%d,%d,%ld,%.3f,%.3f,%.3f,%.3f", r->asteroids, r->width, r->height, r->ticks,
+		    ticks / r->seconds, r->tick_p50_ns / 1e3, r->tick_p99_ns / 1e3, r->tick_max_ns / 1e3);
+	    for (int p = 0; p < WORLD_PHASES; p++) {
+		fprintf(f, ",%.3f", r->phase_ns[p] / 1e3 / ticks);
+	    }
+	    for (int t = 0; t < PAIR_TYPES; t++) {
+		PairCounters *p = &r->collisions.pairs[t];
+		fprintf(f, ",%.3f,%.3f,%.3f", p->pairs / ticks, p->point_tests / ticks, p->hits / ticks);
+	    }
+	    fprintf(f, ",%ld,%ld,%zu,%zu,%ld\n", r->ship_hits, r->replaced, r->entity_bytes,
+		    r->arena_peak_bytes, r->max_rss_kb);
+	}
+    }
+
+    if (json) {
+	fprintf(f, "  ]\n}\n");
+    }
+
+    return fclose(f) == 0;
+}
+
+// Parses a comma separated list of asteroid counts.
+static int parse_counts(const char *arg, int counts[MAX_COUNTS]) {
+    int len = 0;
+    const char *s = arg;
+    while (*s != '\0' && len < MAX_COUNTS) {
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (end == s || n < 1 || n > 1 << 28 || (*end != ',' && *end != '\0')) {
+	    return 0;
+	}
+	counts[len++] = n;
+	s = *end == ',' ? end + 1 : end;
+    }
+    return *s == '\0' ? len : 0;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: bench_scaling [-n count,count,...] [-t ticks] [-d asteroids per Mpx]\n"
+	    "                     [-f shots per tick] [-j threads] [-s seed] [-o results.csv|json]\n"
+	    "                     [-R results dir]\n");
+}
+
+int main(int argc, char **argv) {
+    int counts[MAX_COUNTS] = {10, 100, 1000, 10000, 100000, 1000000};
+    int counts_len = 6;
+    ScalingOptions options = {.ticks = 100, .density = 10, .fire_rate = 0.25, .seed = 1};
+    int threads = 0;
+    const char *output_path = NULL;
+    const char *results_dir = DEFAULT_RESULTS_DIR;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:d:f:j:s:o:R:")) != -1) {
+	switch (opt) {
+	case 'n':
+	    counts_len = parse_counts(optarg, counts);
+	    break;
+	case 't':
+	    options.ticks = atol(optarg);
+	    break;
+	case 'd':
+	    options.density = atof(optarg);
+	    break;
+	case 'f':
+	    options.fire_rate = atof(optarg);
+	    break;
+	case 'j':
+	    threads = atoi(optarg);
+	    break;
+	case 's':
+	    options.seed = strtoull(optarg, NULL, 10);
+	    break;
+	case 'o':
+	    output_path = optarg;
+	    break;
+	case 'R':
+	    results_dir = optarg;
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+
+    if (counts_len < 1 || options.ticks < 1 || !(options.density > 0) || !(options.fire_rate >= 0)) {
+	usage();
+	return 1;
+    }
+
+    ResultsFile samples = {0};
+    if (results_dir[0] != '\0' && !open_results(&samples, results_dir, "bench_scaling", argc, argv)) {
+	fprintf(stderr, "Can't write results to %s\n", results_dir);
+    }
+
+    JobSystem *js = init_job_system(threads);
+
+    ScalingResult results[MAX_COUNTS];
+    for (int i = 0; i < counts_len; i++) {
+	results[i] = run_scaling(js, &options, counts[i], &samples);
+	print_result(&results[i]);
+	fflush(stdout);
+    }
+
+    free_job_system(js);
+
+    if (samples.f != NULL) {
+	if (close_results(&samples)) {
+	    fprintf(stderr, "results written to %s\n", samples.path);
+	} else {
+	    fprintf(stderr, "Can't write results to %s\n", samples.path);
+	}
+    }
+
+    if (output_path != NULL && !write_results(output_path, &options, results, counts_len)) {
+	fprintf(stderr, "Can't write results to %s\n", output_path);
+	return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,356 @@
+#include "collision.h"
+#include <stdlib.h>
+
+#define COLLISION_CHUNK 256
+
+// Counters are optional, the kernels take NULL when nobody is measuring.
+#define COUNT(c, field) do { if ((c) != NULL) (c)->field++; } while (0)
+
+static bool counted_hit(PairCounters *c) {
+    COUNT(c, hits);
+    return true;
+}
+
+static bool counted_reject(PairCounters *c) {
+    COUNT(c, circle_rejects);
+    return false;
+}
+
+bool check_projectile_asteroid_collision(Projectile *p, Asteroid* a, PairCounters *c) {
+    COUNT(c, pairs);
+    if (!CheckCollisionCircles(p->center, p->radius, a->center, a->max_radius)) {
+	return counted_reject(c);
+    }
+
+    COUNT(c, point_tests);
+    if (CheckCollisionPointPoly(p->center, a->vector_coords, a->coords_size)) {
+	return counted_hit(c);
+    }
+
+    Vector2 projectile_circle_points[] = {
+	{p->center.x + p->radius, p->center.y},
+	{p->center.x, p->center.y + p->radius},
+	{p->center.x - p->radius, p->center.y},
+	{p->center.x, p->center.y - p->radius}
+    };
+
+    for (int i = 0; i < sizeof(projectile_circle_points) / sizeof(Vector2); i++) {
+	Vector2 v = projectile_circle_points[i];
+	COUNT(c, point_tests);
+	if (CheckCollisionPointPoly(v, a->vector_coords, a->coords_size)) {
+	    return counted_hit(c);
+	}
+    }
+
+    return false;
+}
+
+bool check_ship_asteroid_collision(Ship* ship, Asteroid* a, PairCounters *c) {
+    COUNT(c, pairs);
+    if (!CheckCollisionCircles(ship->center, ship->max_radius, a->center, a->max_radius)) {
+	return counted_reject(c);
+    }
+
+    COUNT(c, point_tests);
+    if (CheckCollisionPointTriangle(a->center, ship->vertices[0], ship->vertices[1], ship->vertices[2])) {
+	return counted_hit(c);
+    }
+
+    for (int i = 0; i < a->coords_size; i++) {
+	Vector2 v = a->vector_coords[i];
+	COUNT(c, point_tests);
+	if (CheckCollisionPointTriangle(v, ship->vertices[0], ship->vertices[1], ship->vertices[2])) {
+	    return counted_hit(c);
+	}
+    }
+
+    for (int i = 0; i < 3; i++) {
+	COUNT(c, point_tests);
+	if (CheckCollisionPointPoly(ship->vertices[i], a->vector_coords, a->coords_size)) {
+	    return counted_hit(c);
+	}
+    }
+
+    return false;
+}
+
+bool check_two_asteroids_collision(Asteroid *a1, Asteroid* a2, PairCounters *c) {
+    COUNT(c, pairs);
+    if (!CheckCollisionCircles(a1->center, a1->max_radius, a2->center, a2->max_radius)) {
+	return counted_reject(c);
+    }
+
+    for (int i = 0; i < a1->coords_size; i++) {
+	Vector2 v = a1->vector_coords[i];
+	COUNT(c, point_tests);
+	if (CheckCollisionPointPoly(v, a2->vector_coords, a2->coords_size)) {
+	    return counted_hit(c);
+	}
+    }
+
+    for (int i = 0; i < a2->coords_size; i++) {
+	Vector2 v = a2->vector_coords[i];
+	COUNT(c, point_tests);
+	if (CheckCollisionPointPoly(v, a1->vector_coords, a1->coords_size)) {
+	    return counted_hit(c);
+	}
+    }
+
+    return false;
+}
+
+void add_collision_counters(CollisionCounters *to, const CollisionCounters *from) {
+    for (int t = 0; t < PAIR_TYPES; t++) {
+	to->pairs[t].pairs += from->pairs[t].pairs;
+	to->pairs[t].circle_rejects += from->pairs[t].circle_rejects;
+	to->pairs[t].point_tests += from->pairs[t].point_tests;
+	to->pairs[t].hits += from->pairs[t].hits;
+    }
+}
+
+const char *pair_type_name(PairType type) {
+    static const char *names[PAIR_TYPES] = {
+	[PAIR_PROJECTILE_ASTEROID] = "projectile-asteroid",
+	[PAIR_SHIP_ASTEROID] = "ship-asteroid",
+	[PAIR_ASTEROID_ASTEROID] = "asteroid-asteroid",
+    };
+    return names[type];
+}
+
+static int grid_coord(float v, float cell_size, int n) {
+    float c = v / cell_size;
+    if (!(c >= 0)) {
+	return 0;
+    }
+    if (c >= n) {
+	return n - 1;
+    }
+    return (int)c;
+}
+
+static int grid_cell(Grid *g, Vector2 p) {
+    return grid_coord(p.y, g->cell_size, g->rows) * g->cols + grid_coord(p.x, g->cell_size, g->cols);
+}
+
+// Counting sort of the entities by cell. Entities outside of the screen are
+// clamped to the border cells, which keeps neighbours within one cell.
+static void build_grid(Grid *g, Arena *arena, Vector2 (*center)(void *, int), void *v, int len) {
+    int cells = g->cols * g->rows;
+
+    g->start = arena_alloc(arena, sizeof(int) * (cells + 1));
+    g->items = arena_alloc(arena, sizeof(int) * len);
+    int *item_cells = arena_alloc(arena, sizeof(int) * len);
+
+    for (int c = 0; c <= cells; c++) {
+	g->start[c] = 0;
+    }
+
+    for (int i = 0; i < len; i++) {
+	item_cells[i] = grid_cell(g, center(v, i));
+	g->start[item_cells[i] + 1]++;
+    }
+
+    for (int c = 0; c < cells; c++) {
+	g->start[c + 1] += g->start[c];
+    }
+
+    // start[c] is used as the insert position and ends up at start[c + 1]
+    for (int i = 0; i < len; i++) {
+	g->items[g->start[item_cells[i]]++] = i;
+    }
+
+    for (int c = cells; c > 0; c--) {
+	g->start[c] = g->start[c - 1];
+    }
+    g->start[0] = 0;
+}
+
+static Vector2 asteroid_center(void *v, int i) {
+    return ((Asteroid*)v)[i].center;
+}
+
+static Vector2 projectile_center(void *v, int i) {
+    return ((Projectile*)v)[i].center;
+}
+
+static void push_hit(HitList *l, Arena *arena, int asteroid, int other, bool with_projectile) {
+    if (l->last == NULL || l->last->len == HIT_BLOCK_SIZE) {
+	HitBlock *b = arena_alloc(arena, sizeof(HitBlock));
+	b->next = NULL;
+	b->len = 0;
+
+	if (l->last == NULL) {
+	    l->first = b;
+	} else {
+	    l->last->next = b;
+	}
+	l->last = b;
+    }
+
+    l->last->hits[l->last->len++] = (Hit){asteroid, other, with_projectile};
+}
+
+typedef struct {
+    Arena *arena;
+    Grid asteroids_grid;
+    Grid projectiles_grid;
+    HitList *lists;
+    Ship *ship;
+    AsteroidsVector asteroids;
+    ProjectilesVector projectiles;
+    int asteroids_len;
+} DetectContext;
+
+// Hits come out ordered by asteroid, then in the fixed order the grid cells
+// are visited, whatever thread runs the chunk.
+static void detect_chunk(DetectContext *ctx, int chunk) {
+    HitList *l = &ctx->lists[chunk];
+    Grid *ag = &ctx->asteroids_grid;
+    Grid *pg = &ctx->projectiles_grid;
+
+    *l = (HitList){.first = NULL, .last = NULL, .ship_hit = -1};
+    CollisionCounters *c = &l->counters;
+
+    int begin = chunk * COLLISION_CHUNK;
+    int end = begin + COLLISION_CHUNK < ctx->asteroids_len ? begin + COLLISION_CHUNK : ctx->asteroids_len;
+
+    for (int i = begin; i < end; i++) {
+	Asteroid *a1 = &ctx->asteroids.items[i];
+	if (check_ship_asteroid_collision(ctx->ship, a1, &c->pairs[PAIR_SHIP_ASTEROID])) {
+	    l->ship_hit = i;
+	    break;
+	}
+
+	int cx = grid_coord(a1->center.x, ag->cell_size, ag->cols);
+	int cy = grid_coord(a1->center.y, ag->cell_size, ag->rows);
+
+	for (int y = cy - 1; y <= cy + 1; y++) {
+	    if (y < 0 || y >= ag->rows) {
+		continue;
+	    }
+
+	    for (int x = cx - 1; x <= cx + 1; x++) {
+		if (x < 0 || x >= ag->cols) {
+		    continue;
+		}
+		int cell = y * ag->cols + x;
+
+		for (int k = pg->start[cell]; k < pg->start[cell + 1]; k++) {
+		    int j = pg->items[k];
+		    if (check_projectile_asteroid_collision(&ctx->projectiles.items[j], a1, &c->pairs[PAIR_PROJECTILE_ASTEROID])) {
+			push_hit(l, ctx->arena, i, j, true);
+		    }
+		}
+
+		for (int k = ag->start[cell]; k < ag->start[cell + 1]; k++) {
+		    int j = ag->items[k];
+		    if (j > i && check_two_asteroids_collision(a1, &ctx->asteroids.items[j], &c->pairs[PAIR_ASTEROID_ASTEROID])) {
+			push_hit(l, ctx->arena, i, j, false);
+		    }
+		}
+	    }
+	}
+    }
+}
+
+static void detect_chunks(void *ctx, int begin, int end) {
+    for (int chunk = begin; chunk < end; chunk++) {
+	detect_chunk(ctx, chunk);
+    }
+}
+
+CollisionResult detect_collisions(JobSystem *js, Arena *arena, Screen screen, Ship *ship,
+				  AsteroidsVector asteroids, ProjectilesVector projectiles) {
+    int asteroids_len = asteroids_vector_len(asteroids);
+    int projectiles_len = projectiles_vector_len(projectiles);
+
+    CollisionResult result = {
+	.ship_hit = false,
+	.score = 0,
+	.asteroids_to_delete = arena_alloc(arena, sizeof(bool) * asteroids_len),
+	.projectiles_to_delete = arena_alloc(arena, sizeof(bool) * projectiles_len),
+    };
+
+    for (int i = 0; i < asteroids_len; i++) {
+	result.asteroids_to_delete[i] = false;
+    }
+    for (int i = 0; i < projectiles_len; i++) {
+	result.projectiles_to_delete[i] = false;
+    }
+
+    if (asteroids_len == 0) {
+	return result;
+    }
+
+    // Cells are large enough for any two touching entities to sit in
+    // neighbouring cells.
+    float asteroid_radius = 0;
+    for (int i = 0; i < asteroids_len; i++) {
+	asteroid_radius = fmaxf(asteroid_radius, asteroids.items[i].max_radius);
+    }
+    float projectile_radius = 0;
+    for (int i = 0; i < projectiles_len; i++) {
+	projectile_radius = fmaxf(projectile_radius, projectiles.items[i].radius);
+    }
+    float cell_size = fmaxf(2 * asteroid_radius, asteroid_radius + projectile_radius);
+    cell_size = fmaxf(cell_size, 1);
+
+    int cols = ceilf(screen.width / cell_size);
+    int rows = ceilf(screen.height / cell_size);
+    Grid grid = {
+	.cell_size = cell_size,
+	.cols = cols < 1 ? 1 : cols,
+	.rows = rows < 1 ? 1 : rows,
+    };
+
+    int chunks = (asteroids_len + COLLISION_CHUNK - 1) / COLLISION_CHUNK;
+
+    DetectContext ctx = {
+	.arena = arena,
+	.asteroids_grid = grid,
+	.projectiles_grid = grid,
+	.lists = arena_alloc(arena, sizeof(HitList) * chunks),
+	.ship = ship,
+	.asteroids = asteroids,
+	.projectiles = projectiles,
+	.asteroids_len = asteroids_len,
+    };
+
+    build_grid(&ctx.asteroids_grid, arena, asteroid_center, asteroids.items, asteroids_len);
+    build_grid(&ctx.projectiles_grid, arena, projectile_center, projectiles.items, projectiles_len);
+
+    parallel_for(js, chunks, 1, detect_chunks, &ctx);
+
+    // Every chunk did its work, even the ones past a ship hit.
+    for (int c = 0; c < chunks; c++) {
+	add_collision_counters(&result.counters, &ctx.lists[c].counters);
+    }
+
+    // Chunks cover increasing asteroid ranges, so this walks the hits in
+    // asteroid order. Nothing past the first asteroid that hit the ship
+    // counts.
+    for (int c = 0; c < chunks; c++) {
+	HitList *l = &ctx.lists[c];
+
+	for (HitBlock *b = l->first; b != NULL; b = b->next) {
+	    for (int h = 0; h < b->len; h++) {
+		Hit hit = b->hits[h];
+
+		result.asteroids_to_delete[hit.asteroid] = true;
+		if (hit.with_projectile) {
+		    result.projectiles_to_delete[hit.other] = true;
+		    result.score++;
+		} else {
+		    result.asteroids_to_delete[hit.other] = true;
+		}
+	    }
+	}
+
+	if (l->ship_hit >= 0) {
+	    result.ship_hit = true;
+	    break;
+	}
+    }
+
+    return result;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include "arena.h"
+#include "asteroids.h"
+#include "jobs.h"
+#include "projectiles.h"
+#include "screen.h"
+#include "ship.h"
+
+// Work done by one kind of narrowphase test.
+typedef struct {
+    long pairs;          // pairs the broadphase passed to the kernel
+    long circle_rejects; // pairs rejected by the bounding circles
+    long point_tests;    // CheckCollisionPointPoly and CheckCollisionPointTriangle calls
+    long hits;
+} PairCounters;
+
+typedef enum {
+    PAIR_PROJECTILE_ASTEROID,
+    PAIR_SHIP_ASTEROID,
+    PAIR_ASTEROID_ASTEROID,
+    PAIR_TYPES,
+} PairType;
+
+typedef struct {
+    PairCounters pairs[PAIR_TYPES];
+} CollisionCounters;
+
+void add_collision_counters(CollisionCounters *to, const CollisionCounters *from);
+
+const char *pair_type_name(PairType type);
+
+// The kernels count their work into c, which can be NULL.
+bool check_projectile_asteroid_collision(Projectile *p, Asteroid *a, PairCounters *c);
+
+bool check_ship_asteroid_collision(Ship *ship, Asteroid *a, PairCounters *c);
+
+bool check_two_asteroids_collision(Asteroid *a1, Asteroid *a2, PairCounters *c);
+
+typedef struct {
+    int asteroid;
+    int other; // projectile or asteroid index, asteroid ones are always > asteroid
+    bool with_projectile;
+} Hit;
+
+#define HIT_BLOCK_SIZE 64
+
+typedef struct HitBlock {
+    struct HitBlock *next;
+    int len;
+    Hit hits[HIT_BLOCK_SIZE];
+} HitBlock;
+
+// Hits of one chunk of asteroids, in asteroid order.
+typedef struct {
+    HitBlock *first;
+    HitBlock *last;
+    int ship_hit; // first asteroid of the chunk that hit the ship, -1 if none
+    CollisionCounters counters;
+} HitList;
+
+// Uniform grid over the screen, items holds entity indices ordered by cell.
+typedef struct {
+    float cell_size;
+    int cols;
+    int rows;
+    int *start;
+    int *items;
+} Grid;
+
+typedef struct {
+    bool ship_hit;
+    int score;
+    bool *asteroids_to_delete;
+    bool *projectiles_to_delete;
+    CollisionCounters counters;
+} CollisionResult;
+
+// Finds every hit of the tick. Asteroids are checked in chunks spread over
+// the job system, each chunk collecting hits in its own list; the lists are
+// then applied in asteroid order, so the result is the same as checking the
+// asteroids one by one and stopping at the first one that hits the ship.
+// The grids, hit lists and returned masks live in the frame arena.
+CollisionResult detect_collisions(JobSystem *js, Arena *arena, Screen screen, Ship *ship,
+				  AsteroidsVector asteroids, ProjectilesVector projectiles);
@@ -0,0 +1,105 @@
+#include "collision_reference.h"
+#include <math.h>
+
+static bool circles(Vector2 center1, float radius1, Vector2 center2, float radius2) {
+    float dx = center2.x - center1.x;
+    float dy = center2.y - center1.y;
+    float distance = sqrtf(dx * dx + dy * dy);
+    return distance <= radius1 + radius2;
+}
+
+// Even-odd rule: a ray from the point crosses the edges an odd number of
+// times when it's inside. Like raylib 5.0, the closing edge from the last
+// vertex back to the first is never crossed, so points only that edge
+// separates from the outside count as outside.
+static bool point_in_poly(Vector2 point, const Vector2 *points, int count) {
+    bool inside = false;
+    if (count <= 2) {
+	return false;
+    }
+
+    for (int i = 0; i < count - 1; i++) {
+	Vector2 vc = points[i];
+	Vector2 vn = points[i + 1];
+	if (((vc.y >= point.y && vn.y < point.y) || (vc.y < point.y && vn.y >= point.y)) &&
+	    point.x < (vn.x - vc.x) * (point.y - vc.y) / (vn.y - vc.y) + vc.x) {
+	    inside = !inside;
+	}
+    }
+    return inside;
+}
+
+// Barycentric coordinates, points on an edge are outside.
+static bool point_in_triangle(Vector2 point, Vector2 p1, Vector2 p2, Vector2 p3) {
+    float alpha = ((p2.y - p3.y) * (point.x - p3.x) + (p3.x - p2.x) * (point.y - p3.y)) /
+	((p2.y - p3.y) * (p1.x - p3.x) + (p3.x - p2.x) * (p1.y - p3.y));
+    float beta = ((p3.y - p1.y) * (point.x - p3.x) + (p1.x - p3.x) * (point.y - p3.y)) /
+	((p2.y - p3.y) * (p1.x - p3.x) + (p3.x - p2.x) * (p1.y - p3.y));
+    float gamma = 1.0f - alpha - beta;
+    return alpha > 0 && beta > 0 && gamma > 0;
+}
+
+bool reference_projectile_asteroid_collision(Projectile *p, Asteroid *a) {
+    if (!circles(p->center, p->radius, a->center, a->max_radius)) {
+	return false;
+    }
+
+    // The center and four points of the projectile's circle.
+    Vector2 points[] = {
+	p->center,
+	{p->center.x + p->radius, p->center.y},
+	{p->center.x, p->center.y + p->radius},
+	{p->center.x - p->radius, p->center.y},
+	{p->center.x, p->center.y - p->radius},
+    };
+
+    for (int i = 0; i < 5; i++) {
+	if (point_in_poly(points[i], a->vector_coords, a->coords_size)) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool reference_ship_asteroid_collision(Ship *ship, Asteroid *a) {
+    if (!circles(ship->center, ship->max_radius, a->center, a->max_radius)) {
+	return false;
+    }
+
+    Vector2 *v = ship->vertices;
+    if (point_in_triangle(a->center, v[0], v[1], v[2])) {
+	return true;
+    }
+
+    for (int i = 0; i < a->coords_size; i++) {
+	if (point_in_triangle(a->vector_coords[i], v[0], v[1], v[2])) {
+	    return true;
+	}
+    }
+
+    for (int i = 0; i < 3; i++) {
+	if (point_in_poly(v[i], a->vector_coords, a->coords_size)) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool reference_two_asteroids_collision(Asteroid *a1, Asteroid *a2) {
+    if (!circles(a1->center, a1->max_radius, a2->center, a2->max_radius)) {
+	return false;
+    }
+
+    for (int i = 0; i < a1->coords_size; i++) {
+	if (point_in_poly(a1->vector_coords[i], a2->vector_coords, a2->coords_size)) {
+	    return true;
+	}
+    }
+
+    for (int i = 0; i < a2->coords_size; i++) {
+	if (point_in_poly(a2->vector_coords[i], a1->vector_coords, a1->coords_size)) {
+	    return true;
+	}
+    }
+    return false;
+}
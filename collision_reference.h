@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+#include "asteroids.h"
+#include "projectiles.h"
+#include "ship.h"
+
+// Reference versions of the collision kernels for differential testing. They
+// follow the algorithm of the kernels in collision.c as first written, on
+// local copies of the raylib 5.0 CheckCollisionCircles,
+// CheckCollisionPointPoly and CheckCollisionPointTriangle, so a faster
+// kernel can be checked against them even once it no longer calls raylib.
+// Keep them slow and obvious.
+
+bool reference_projectile_asteroid_collision(Projectile *p, Asteroid *a);
+
+bool reference_ship_asteroid_collision(Ship *ship, Asteroid *a);
+
+bool reference_two_asteroids_collision(Asteroid *a1, Asteroid *a2);
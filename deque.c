@@ -1,32 +1,103 @@
 #include <stdlib.h>
 #include <assert.h>
+#include "alloc.h"
 #include "deque.h"
 
-Deque* init_deque() {
-    Node* sentinel_first = malloc(sizeof(Node));
-    assert(sentinel_first != NULL && "Can't allocate sentinel first");
+#define DEFAULT_SLAB_SIZE 64
+
+NodePool* init_node_pool(int slab_size) {
+    assert(slab_size > 0 && "Slab size must be positive");
+
+    NodePool* pool = tracked_malloc(sizeof(NodePool));
+    assert(pool != NULL && "Can't allocate node pool");
+
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pool->slab_size = slab_size;
 
-    Node* sentinel_last = malloc(sizeof(Node));
-    assert(sentinel_last != NULL && "Can't allocate sentinel last");
+    return pool;
+}
+
+void free_node_pool(NodePool* pool) {
+    NodeSlab* slab = pool->slabs;
+    while (slab != NULL) {
+	NodeSlab* next = slab->next;
+	tracked_free(slab);
+	slab = next;
+    }
+    tracked_free(pool);
+}
+
+Node* alloc_node(NodePool* pool) {
+    if (pool->free_list == NULL) {
+	NodeSlab* slab = tracked_malloc(sizeof(NodeSlab) + sizeof(Node) * pool->slab_size);
+	assert(slab != NULL && "Can't allocate node slab");
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	// Thread the free list so nodes come out in address order.
+	for (int i = pool->slab_size - 1; i >= 0; i--) {
+	    slab->nodes[i].next = pool->free_list;
+	    pool->free_list = &slab->nodes[i];
+	}
+    }
+
+    Node* n = pool->free_list;
+    pool->free_list = n->next;
+
+    return n;
+}
 
+void release_node(NodePool* pool, Node* node) {
+    node->next = pool->free_list;
+    pool->free_list = node;
+}
+
+Deque* init_deque_with_pool(NodePool* pool) {
+    Deque* dq = tracked_malloc(sizeof(Deque));
+    assert(dq != NULL && "Can't allocate dq");
+
+    Node* sentinel_first = &dq->sentinels[0];
+    Node* sentinel_last = &dq->sentinels[1];
+
+    sentinel_first->prev = NULL;
     sentinel_first->next = sentinel_last;
     sentinel_first->val = NULL;
 
     sentinel_last->prev = sentinel_first;
+    sentinel_last->next = NULL;
     sentinel_last->val = NULL;
 
-    Deque* dq = malloc(sizeof(Deque));
-    assert(dq != NULL && "Can't allocate dq");
-
     dq->first = sentinel_first;
     dq->last = sentinel_last;
+    dq->count = 0;
+    dq->pool = pool;
+    dq->owns_pool = false;
+
+    return dq;
+}
+
+Deque* init_deque() {
+    Deque* dq = init_deque_with_pool(init_node_pool(DEFAULT_SLAB_SIZE));
+    dq->owns_pool = true;
 
     return dq;
 }
 
+void free_deque(Deque* dq) {
+    while (dq->count > 0) {
+	remove_node(dq, dq->first->next);
+    }
+
+    if (dq->owns_pool) {
+	free_node_pool(dq->pool);
+    }
+    tracked_free(dq);
+}
+
 void prepend_node(Deque* dq, void* val) {
-    Node* n = malloc(sizeof(Node));
-    assert(n != NULL && "Can't allocate sentinel first");
+    Node* n = alloc_node(dq->pool);
 
     Node* first = dq->first;
 
@@ -43,14 +114,93 @@ void prepend_node(Deque* dq, void* val) {
 }
 
 void remove_node(Deque* dq, Node* node) {
-    free(node->val);
+    tracked_free(node->val);
     Node* prev_node = node->prev;
     Node* next_node = node->next;
 
     prev_node->next = next_node;
     next_node->prev = prev_node;
 
-    free(node);
+    release_node(dq->pool, node);
 
     dq->count--;
 }
+
+StealDeque* init_steal_deque(int capacity) {
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0 && "Capacity must be a power of two");
+
+    StealDeque* dq = tracked_malloc(sizeof(StealDeque));
+    assert(dq != NULL && "Can't allocate steal deque");
+
+    dq->items = tracked_malloc(sizeof(_Atomic(void*)) * capacity);
+    assert(dq->items != NULL && "Can't allocate steal deque items");
+
+    atomic_init(&dq->top, 0);
+    atomic_init(&dq->bottom, 0);
+    dq->mask = capacity - 1;
+
+    return dq;
+}
+
+void free_steal_deque(StealDeque* dq) {
+    tracked_free(dq->items);
+    tracked_free(dq);
+}
+
+bool push_bottom(StealDeque* dq, void* val) {
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+
+    if (b - t > dq->mask) {
+	return false;
+    }
+
+    atomic_store_explicit(&dq->items[b & dq->mask], val, memory_order_relaxed);
+    atomic_store_explicit(&dq->bottom, b + 1, memory_order_release);
+
+    return true;
+}
+
+void* pop_bottom(StealDeque* dq) {
+    long b = atomic_load_explicit(&dq->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&dq->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&dq->top, memory_order_relaxed);
+
+    if (t > b) {
+	atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+	return NULL;
+    }
+
+    void* val = atomic_load_explicit(&dq->items[b & dq->mask], memory_order_relaxed);
+
+    if (t == b) {
+	// Last item, race the thieves for it.
+	if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+						     memory_order_seq_cst, memory_order_relaxed)) {
+	    val = NULL;
+	}
+	atomic_store_explicit(&dq->bottom, b + 1, memory_order_relaxed);
+    }
+
+    return val;
+}
+
+void* steal_top(StealDeque* dq) {
+    long t = atomic_load_explicit(&dq->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&dq->bottom, memory_order_acquire);
+
+    if (t >= b) {
+	return NULL;
+    }
+
+    void* val = atomic_load_explicit(&dq->items[t & dq->mask], memory_order_relaxed);
+
+    if (!atomic_compare_exchange_strong_explicit(&dq->top, &t, t + 1,
+						 memory_order_seq_cst, memory_order_relaxed)) {
+	return NULL;
+    }
+
+    return val;
+}
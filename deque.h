@@ -1,17 +1,73 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
 typedef struct Node {
     struct Node* prev;
     struct Node* next;
     void* val;
 } Node;
 
+typedef struct NodeSlab {
+    struct NodeSlab* next;
+    Node nodes[];
+} NodeSlab;
+
+// Nodes are carved out of slabs and recycled through an intrusive free list
+// (threaded through Node.next), so steady node churn never hits malloc. A
+// pool can be shared by several deques of the same thread.
+typedef struct {
+    NodeSlab* slabs;
+    Node* free_list;
+    int slab_size;
+} NodePool;
+
+NodePool* init_node_pool(int slab_size);
+
+void free_node_pool(NodePool *pool);
+
+Node* alloc_node(NodePool *pool);
+
+void release_node(NodePool *pool, Node *node);
+
 typedef struct {
     Node* first;
     Node* last;
     int count;
+    NodePool* pool;
+    bool owns_pool;
+    Node sentinels[2];
 } Deque;
 
+// The deque owns its values: remove_node and free_deque free them, so they
+// must come from tracked_malloc.
 void prepend_node(Deque *dq, void *val);
 
 Deque* init_deque();
 
+Deque* init_deque_with_pool(NodePool *pool);
+
+void free_deque(Deque *dq);
+
 void remove_node(Deque *dq, Node *node);
+
+// Chase-Lev work-stealing deque: the owner thread pushes and pops at the
+// bottom, any other thread may steal from the top. Capacity is fixed and must
+// be a power of two.
+typedef struct {
+    atomic_long top;
+    atomic_long bottom;
+    long mask;
+    _Atomic(void*)* items;
+} StealDeque;
+
+StealDeque* init_steal_deque(int capacity);
+
+void free_steal_deque(StealDeque *dq);
+
+bool push_bottom(StealDeque *dq, void *val);
+
+void* pop_bottom(StealDeque *dq);
+
+void* steal_top(StealDeque *dq);
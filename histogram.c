@@ -0,0 +1,105 @@
+#include "histogram.h"
+#include <stdio.h>
+#include <string.h>
+
+static int bucket_of(uint64_t v) {
+    if (v < HISTOGRAM_SUB_BUCKETS) {
+	return v;
+    }
+
+    int shift = 63 - __builtin_clzll(v) - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + ((v >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+// Largest value that falls into bucket b.
+static uint64_t bucket_top(int b) {
+    if (b < HISTOGRAM_SUB_BUCKETS) {
+	return b;
+    }
+
+    int shift = b / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t base = (uint64_t)(HISTOGRAM_SUB_BUCKETS + b % HISTOGRAM_SUB_BUCKETS) << shift;
+    return base + (((uint64_t)1 << shift) - 1);
+}
+
+void init_histogram(Histogram *h) {
+    memset(h, 0, sizeof(Histogram));
+    h->min = UINT64_MAX;
+}
+
+void record_histogram(Histogram *h, uint64_t value) {
+    h->counts[bucket_of(value)]++;
+    h->total++;
+    if (value < h->min) {
+	h->min = value;
+    }
+    if (value > h->max) {
+	h->max = value;
+    }
+}
+
+uint64_t histogram_percentile(Histogram *h, double p) {
+    if (h->total == 0) {
+	return 0;
+    }
+
+    uint64_t rank = (uint64_t)(p / 100 * h->total + 0.5);
+    if (rank < 1) {
+	rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+	seen += h->counts[b];
+	if (seen >= rank) {
+	    uint64_t top = bucket_top(b);
+	    return top < h->max ? top : h->max;
+	}
+    }
+
+    return h->max;
+}
+
+static const double report_percentiles[] = {50, 90, 99, 99.9};
+
+bool write_histogram_report(const char *path, NamedHistogram *hs, int count) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+	return false;
+    }
+
+    size_t len = strlen(path);
+    bool json = len >= 5 && strcmp(path + len - 5, ".json") == 0;
+
+    if (json) {
+	fprintf(f, "{\n");
+    } else {
+	fprintf(f, "name,count,min_us,p50_us,p90_us,p99_us,p99.9_us,max_us\n");
+    }
+
+    for (int i = 0; i < count; i++) {
+	Histogram *h = hs[i].histogram;
+	double values[4];
+	for (int p = 0; p < 4; p++) {
+	    values[p] = histogram_percentile(h, report_percentiles[p]) / 1e3;
+	}
+	double min = h->total > 0 ? h->min / 1e3 : 0;
+	double max = h->max / 1e3;
+
+	if (json) {
+	    fprintf(f, "  \"%s\": {\"count\": %llu, \"min_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, "
+		    "\"p99_us\": %.3f, \"p99.9_us\": %.3f, \"max_us\": %.3f}%s\n",
+		    hs[i].name, (unsigned long long)h->total, min, values[0], values[1], values[2],
+		    values[3], max, i + 1 < count ? "," : "");
+	} else {
+	    fprintf(f, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", hs[i].name, (unsigned long long)h->total,
+		    min, values[0], values[1], values[2], values[3], max);
+	}
+    }
+
+    if (json) {
+	fprintf(f, "}\n");
+    }
+
+    return fclose(f) == 0;
+}
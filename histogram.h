@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Log-bucketed histogram in the style of HdrHistogram: every power of two
+// is split into HISTOGRAM_SUB_BUCKETS linear buckets, so any value from 1 ns
+// to centuries is kept with about 3% relative error in a fixed 15 KiB.
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+} Histogram;
+
+void init_histogram(Histogram *h);
+
+void record_histogram(Histogram *h, uint64_t value);
+
+// Smallest recorded value that at least p percent of the values don't
+// exceed, up to the bucket precision.
+uint64_t histogram_percentile(Histogram *h, double p);
+
+typedef struct {
+    const char *name;
+    Histogram *histogram;
+} NamedHistogram;
+
+// Writes count, min, p50, p90, p99, p99.9 and max of every histogram in
+// microseconds. The file is JSON when path ends in .json, CSV otherwise.
+bool write_histogram_report(const char *path, NamedHistogram *hs, int count);
@@ -0,0 +1,154 @@
+#include "input.h"
+#include "include/raylib.h"
+#include "timing.h"
+
+#define PUMP_INTERVAL_NS 1000000
+
+static const int input_keys[INPUT_KEYS] = {
+    [INPUT_LEFT] = KEY_LEFT,
+    [INPUT_RIGHT] = KEY_RIGHT,
+    [INPUT_UP] = KEY_UP,
+    [INPUT_DOWN] = KEY_DOWN,
+    [INPUT_FIRE] = KEY_SPACE,
+};
+
+void init_input_queue(InputQueue *q) {
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+bool push_input_event(InputQueue *q, InputEvent e) {
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    if (tail - head == INPUT_QUEUE_SIZE) {
+	return false;
+    }
+
+    q->events[tail % INPUT_QUEUE_SIZE] = e;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+bool pop_input_event(InputQueue *q, InputEvent *e) {
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    if (head == tail) {
+	return false;
+    }
+
+    *e = q->events[head % INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+void init_input_poller(InputPoller *p, InputQueue *q) {
+    p->queue = q;
+    for (int i = 0; i < INPUT_KEYS; i++) {
+	p->down[i] = false;
+    }
+}
+
+void poll_input(InputPoller *p) {
+    uint64_t t = now_ns();
+
+    for (int i = 0; i < INPUT_KEYS; i++) {
+	bool down = IsKeyDown(input_keys[i]);
+	if (down != p->down[i]) {
+	    p->down[i] = down;
+	    push_input_event(p->queue, (InputEvent){t, input_keys[i], down ? KEY_EVENT_DOWN : KEY_EVENT_UP});
+	}
+    }
+
+    // The press queue keeps keys that went down and up again between two polls.
+    int key;
+    while ((key = GetKeyPressed()) != 0) {
+	push_input_event(p->queue, (InputEvent){t, key, KEY_EVENT_PRESSED});
+    }
+}
+
+void pump_input(InputPoller *p, uint64_t deadline_ns) {
+    for (;;) {
+	uint64_t t = now_ns();
+	if (t >= deadline_ns) {
+	    return;
+	}
+
+	uint64_t left = deadline_ns - t;
+	sleep_ns(left < PUMP_INTERVAL_NS ? left : PUMP_INTERVAL_NS);
+
+	PollInputEvents();
+	poll_input(p);
+    }
+}
+
+static int input_key_index(int key) {
+    for (int i = 0; i < INPUT_KEYS; i++) {
+	if (input_keys[i] == key) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+void init_tick_input(TickInput *in) {
+    for (int i = 0; i < INPUT_KEYS; i++) {
+	in->held[i] = false;
+    }
+}
+
+void collect_tick_input(InputQueue *q, TickInput *in, uint64_t now_ns, uint64_t tick_ns) {
+    for (int i = 0; i < INPUT_KEYS; i++) {
+	in->active[i] = in->held[i];
+    }
+    in->shots = 0;
+    in->typed_len = 0;
+
+    InputEvent e;
+    while (pop_input_event(q, &e)) {
+	int i = input_key_index(e.key);
+
+	switch (e.type) {
+	case KEY_EVENT_DOWN:
+	    in->held[i] = true;
+	    in->active[i] = true;
+	    break;
+	case KEY_EVENT_UP:
+	    in->held[i] = false;
+	    break;
+	case KEY_EVENT_PRESSED:
+	    if (i >= 0) {
+		in->active[i] = true;
+	    }
+
+	    if (i == INPUT_FIRE && in->shots < MAX_SHOTS_PER_TICK) {
+		float lead = e.time_ns < now_ns ? (float)(now_ns - e.time_ns) / tick_ns : 0;
+		in->shot_lead[in->shots++] = lead > 1 ? 1 : lead;
+	    }
+
+	    if (in->typed_len < MAX_TYPED_PER_TICK) {
+		in->typed[in->typed_len++] = e.key;
+	    }
+	    break;
+	}
+    }
+}
+
+WorldInput world_input(const TickInput *in) {
+    WorldInput wi = {
+	.keys = (in->active[INPUT_LEFT] ? WORLD_LEFT : 0) |
+	    (in->active[INPUT_RIGHT] ? WORLD_RIGHT : 0) |
+	    (in->active[INPUT_UP] ? WORLD_UP : 0) |
+	    (in->active[INPUT_DOWN] ? WORLD_DOWN : 0),
+	.shots = in->shots,
+    };
+
+    for (int i = 0; i < in->shots; i++) {
+	wi.shot_lead[i] = in->shot_lead[i];
+    }
+
+    return wi;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "world.h"
+
+#define INPUT_QUEUE_SIZE 1024
+#define MAX_TYPED_PER_TICK 32
+
+typedef enum { INPUT_LEFT, INPUT_RIGHT, INPUT_UP, INPUT_DOWN, INPUT_FIRE, INPUT_KEYS } InputKey;
+
+typedef enum { KEY_EVENT_DOWN, KEY_EVENT_UP, KEY_EVENT_PRESSED } KeyEventType;
+
+typedef struct {
+    uint64_t time_ns;
+    int key; // raylib key code
+    KeyEventType type;
+} InputEvent;
+
+// Lock-free single producer, single consumer ring of input events.
+typedef struct {
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+    InputEvent events[INPUT_QUEUE_SIZE];
+} InputQueue;
+
+void init_input_queue(InputQueue *q);
+
+bool push_input_event(InputQueue *q, InputEvent e);
+
+bool pop_input_event(InputQueue *q, InputEvent *e);
+
+// Producer side: turns raylib's keyboard state into timestamped events.
+typedef struct {
+    InputQueue *queue;
+    bool down[INPUT_KEYS];
+} InputPoller;
+
+void init_input_poller(InputPoller *p, InputQueue *q);
+
+// Samples the state raylib got from its last PollInputEvents.
+void poll_input(InputPoller *p);
+
+// Polls events about once per millisecond until deadline_ns. GLFW only lets
+// the main thread poll, so this replaces the sleep at the end of a frame.
+void pump_input(InputPoller *p, uint64_t deadline_ns);
+
+// Consumer side: what the simulation sees of one tick.
+typedef struct {
+    bool held[INPUT_KEYS];   // down at the end of the tick
+    bool active[INPUT_KEYS]; // down at any moment of the tick, taps included
+    int shots;
+    float shot_lead[MAX_SHOTS_PER_TICK]; // part of a tick since the shot was fired
+    int typed[MAX_TYPED_PER_TICK];
+    int typed_len;
+} TickInput;
+
+void init_tick_input(TickInput *in);
+
+// Drains the queue into the input of the tick that runs at now_ns.
+void collect_tick_input(InputQueue *q, TickInput *in, uint64_t now_ns, uint64_t tick_ns);
+
+WorldInput world_input(const TickInput *in);
@@ -0,0 +1,418 @@
+#include "jobs.h"
+#include "alloc.h"
+#include "deque.h"
+#include "trace.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define JOB_QUEUE_SIZE 4096
+#define IDLE_SPINS 64
+#define RANGES_PER_WORKER 4
+#define DEFERRED_JOBS 64
+
+typedef struct {
+    JobFn fn;
+    void *ctx;
+    int begin;
+    int end;
+    JobCounter *counter;
+    JobCounter *dependency;
+    atomic_bool busy;
+} Job;
+
+typedef struct {
+    _Alignas(64) JobSystem *js;
+    int index;
+    pthread_t thread;
+    StealDeque *queue;
+    Job *jobs; // ring, reused once a job has finished
+    int next_job;
+    Job *deferred[DEFERRED_JOBS];
+    int deferred_len;
+    unsigned int seed;
+    PerfCounters perf; // only with perf_open, see count_job_perf
+    bool perf_tried;
+    bool perf_open;
+    _Atomic uint64_t perf_totals[COUNTERS];
+} Worker;
+
+struct JobSystem {
+    Worker *workers;
+    int workers_count;
+    atomic_bool shutdown;
+    atomic_int sleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    long wake_seq;
+    atomic_bool count_perf;
+};
+
+static _Thread_local Worker *current_worker = NULL;
+
+static Worker *worker_for(JobSystem *js) {
+    Worker *w = current_worker;
+    return (js != NULL && w != NULL && w->js == js) ? w : NULL;
+}
+
+static bool is_ready(JobCounter *dependency) {
+    return dependency == NULL || atomic_load_explicit(&dependency->pending, memory_order_acquire) == 0;
+}
+
+static void wake_workers(JobSystem *js) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&js->sleeping, memory_order_relaxed) == 0) {
+	return;
+    }
+
+    pthread_mutex_lock(&js->lock);
+    js->wake_seq++;
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->lock);
+}
+
+// The counters are opened by the worker itself, they count the thread that
+// opens them.
+static bool open_job_perf(Worker *w) {
+    if (!w->perf_tried && w->index > 0 && atomic_load_explicit(&w->js->count_perf, memory_order_relaxed)) {
+	w->perf_tried = true;
+	w->perf_open = init_perf_counters(&w->perf);
+    }
+    return w->perf_open;
+}
+
+static void run_job(Worker *w, Job *job) {
+    JobSystem *js = w->js;
+    JobCounter *counter = job->counter;
+
+    bool count = open_job_perf(w);
+    uint64_t before[COUNTERS];
+    if (count) {
+	read_perf_counters(&w->perf, before);
+    }
+
+    uint64_t t = trace_begin();
+    job->fn(job->ctx, job->begin, job->end);
+    trace_end("job", t);
+
+    // Added before the counter drops, a waiter sees the totals of its jobs.
+    if (count) {
+	uint64_t after[COUNTERS];
+	read_perf_counters(&w->perf, after);
+	for (int k = 0; k < COUNTERS; k++) {
+	    atomic_fetch_add_explicit(&w->perf_totals[k], after[k] - before[k], memory_order_relaxed);
+	}
+    }
+
+    atomic_store_explicit(&job->busy, false, memory_order_release);
+
+    // A job parked on this counter by a worker that went to sleep only runs
+    // once that worker wakes up.
+    if (counter != NULL && atomic_fetch_sub_explicit(&counter->pending, 1, memory_order_acq_rel) == 1) {
+	wake_workers(js);
+    }
+}
+
+static bool push_job(Worker *w, JobFn fn, void *ctx, int begin, int end, JobCounter *counter, JobCounter *dependency) {
+    Job *job = &w->jobs[w->next_job];
+    if (atomic_load_explicit(&job->busy, memory_order_acquire)) {
+	return false;
+    }
+
+    job->fn = fn;
+    job->ctx = ctx;
+    job->begin = begin;
+    job->end = end;
+    job->counter = counter;
+    job->dependency = dependency;
+    atomic_store_explicit(&job->busy, true, memory_order_relaxed);
+
+    if (counter != NULL) {
+	atomic_fetch_add_explicit(&counter->pending, 1, memory_order_relaxed);
+    }
+
+    if (!push_bottom(w->queue, job)) {
+	atomic_store_explicit(&job->busy, false, memory_order_relaxed);
+	if (counter != NULL) {
+	    atomic_fetch_sub_explicit(&counter->pending, 1, memory_order_relaxed);
+	}
+	return false;
+    }
+
+    w->next_job = (w->next_job + 1) & (JOB_QUEUE_SIZE - 1);
+    return true;
+}
+
+// Jobs whose dependency is still pending are parked on the worker that found
+// them, they can't run anywhere else anyway. If there is no room left we help
+// with other work until the job is ready.
+static Job *defer_job(Worker *w, Job *job) {
+    if (w->deferred_len < DEFERRED_JOBS) {
+	w->deferred[w->deferred_len++] = job;
+	return NULL;
+    }
+
+    wait_for_jobs(w->js, job->dependency);
+    return job;
+}
+
+static Job *take_ready(Worker *w, Job *job) {
+    if (is_ready(job->dependency)) {
+	return job;
+    }
+    return defer_job(w, job);
+}
+
+static Job *find_job(Worker *w) {
+    JobSystem *js = w->js;
+
+    for (int i = 0; i < w->deferred_len; i++) {
+	Job *job = w->deferred[i];
+	if (is_ready(job->dependency)) {
+	    w->deferred[i] = w->deferred[--w->deferred_len];
+	    return job;
+	}
+    }
+
+    Job *job;
+    while ((job = pop_bottom(w->queue)) != NULL) {
+	if ((job = take_ready(w, job)) != NULL) {
+	    return job;
+	}
+    }
+
+    w->seed = w->seed * 1103515245 + 12345;
+    int start = (w->seed >> 16) % js->workers_count;
+
+    for (int i = 0; i < js->workers_count; i++) {
+	Worker *victim = &js->workers[(start + i) % js->workers_count];
+	if (victim == w) {
+	    continue;
+	}
+
+	while ((job = steal_top(victim->queue)) != NULL) {
+	    if ((job = take_ready(w, job)) != NULL) {
+		return job;
+	    }
+	}
+    }
+
+    return NULL;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    JobSystem *js = w->js;
+    current_worker = w;
+
+    int idle = 0;
+    while (!atomic_load(&js->shutdown)) {
+	Job *job = find_job(w);
+	if (job != NULL) {
+	    run_job(w, job);
+	    idle = 0;
+	    continue;
+	}
+
+	if (++idle < IDLE_SPINS) {
+	    sched_yield();
+	    continue;
+	}
+
+	pthread_mutex_lock(&js->lock);
+	long seq = js->wake_seq;
+	pthread_mutex_unlock(&js->lock);
+
+	// Look once more after announcing we sleep, a job pushed meanwhile
+	// is either found here or its submitter sees us and wakes us up.
+	atomic_fetch_add(&js->sleeping, 1);
+	job = find_job(w);
+	if (job == NULL) {
+	    pthread_mutex_lock(&js->lock);
+	    while (js->wake_seq == seq && !atomic_load(&js->shutdown)) {
+		pthread_cond_wait(&js->wake, &js->lock);
+	    }
+	    pthread_mutex_unlock(&js->lock);
+	}
+	atomic_fetch_sub(&js->sleeping, 1);
+
+	if (job != NULL) {
+	    run_job(w, job);
+	}
+	idle = 0;
+    }
+
+    return NULL;
+}
+
+JobSystem *init_job_system(int workers) {
+    if (workers <= 0) {
+	workers = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (workers < 1) {
+	workers = 1;
+    }
+
+    JobSystem *js = tracked_malloc(sizeof(JobSystem));
+    assert(js != NULL && "Can't allocate job system");
+
+    js->workers = tracked_aligned_alloc(_Alignof(Worker), sizeof(Worker) * workers);
+    assert(js->workers != NULL && "Can't allocate workers");
+
+    js->workers_count = workers;
+    atomic_init(&js->shutdown, false);
+    atomic_init(&js->sleeping, 0);
+    pthread_mutex_init(&js->lock, NULL);
+    pthread_cond_init(&js->wake, NULL);
+    js->wake_seq = 0;
+    atomic_init(&js->count_perf, false);
+
+    for (int i = 0; i < workers; i++) {
+	Worker *w = &js->workers[i];
+	w->js = js;
+	w->index = i;
+	w->queue = init_steal_deque(JOB_QUEUE_SIZE);
+	w->jobs = tracked_malloc(sizeof(Job) * JOB_QUEUE_SIZE);
+	assert(w->jobs != NULL && "Can't allocate jobs");
+	for (int j = 0; j < JOB_QUEUE_SIZE; j++) {
+	    atomic_init(&w->jobs[j].busy, false);
+	}
+	w->next_job = 0;
+	w->seed = i + 1;
+	w->perf_tried = false;
+	w->perf_open = false;
+	for (int k = 0; k < COUNTERS; k++) {
+	    atomic_init(&w->perf_totals[k], 0);
+	}
+    }
+
+    current_worker = &js->workers[0];
+
+    for (int i = 1; i < workers; i++) {
+	int err = pthread_create(&js->workers[i].thread, NULL, worker_main, &js->workers[i]);
+	assert(err == 0 && "Can't start worker thread");
+    }
+
+    return js;
+}
+
+void free_job_system(JobSystem *js) {
+    atomic_store(&js->shutdown, true);
+
+    pthread_mutex_lock(&js->lock);
+    js->wake_seq++;
+    pthread_cond_broadcast(&js->wake);
+    pthread_mutex_unlock(&js->lock);
+
+    for (int i = 1; i < js->workers_count; i++) {
+	pthread_join(js->workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < js->workers_count; i++) {
+	free_steal_deque(js->workers[i].queue);
+	tracked_free(js->workers[i].jobs);
+	if (js->workers[i].perf_open) {
+	    free_perf_counters(&js->workers[i].perf);
+	}
+    }
+
+    if (worker_for(js) != NULL) {
+	current_worker = NULL;
+    }
+
+    pthread_mutex_destroy(&js->lock);
+    pthread_cond_destroy(&js->wake);
+    tracked_free(js->workers);
+    tracked_free(js);
+}
+
+int job_system_workers(JobSystem *js) {
+    return js == NULL ? 1 : js->workers_count;
+}
+
+void submit_job_after(JobSystem *js, JobCounter *dependency, JobFn fn, void *ctx, int begin, int end, JobCounter *counter) {
+    Worker *w = worker_for(js);
+
+    if (w != NULL && push_job(w, fn, ctx, begin, end, counter, dependency)) {
+	wake_workers(js);
+	return;
+    }
+
+    if (w != NULL && dependency != NULL) {
+	wait_for_jobs(js, dependency);
+    }
+    while (!is_ready(dependency)) {
+	sched_yield();
+    }
+
+    fn(ctx, begin, end);
+}
+
+void submit_job(JobSystem *js, JobFn fn, void *ctx, int begin, int end, JobCounter *counter) {
+    submit_job_after(js, NULL, fn, ctx, begin, end, counter);
+}
+
+void wait_for_jobs(JobSystem *js, JobCounter *counter) {
+    Worker *w = worker_for(js);
+
+    while (atomic_load_explicit(&counter->pending, memory_order_acquire) > 0) {
+	Job *job = w != NULL ? find_job(w) : NULL;
+	if (job != NULL) {
+	    run_job(w, job);
+	} else {
+	    sched_yield();
+	}
+    }
+}
+
+void parallel_for(JobSystem *js, int count, int grain, JobFn fn, void *ctx) {
+    if (count <= 0) {
+	return;
+    }
+    if (grain < 1) {
+	grain = 1;
+    }
+
+    Worker *w = worker_for(js);
+    if (w == NULL || js->workers_count == 1 || count <= grain) {
+	fn(ctx, 0, count);
+	return;
+    }
+
+    int ranges = js->workers_count * RANGES_PER_WORKER;
+    int chunk = (count + ranges - 1) / ranges;
+    if (chunk < grain) {
+	chunk = grain;
+    }
+
+    JobCounter counter;
+    atomic_init(&counter.pending, 0);
+
+    for (int begin = chunk; begin < count; begin += chunk) {
+	int end = count - begin < chunk ? count : begin + chunk;
+	if (!push_job(w, fn, ctx, begin, end, &counter, NULL)) {
+	    fn(ctx, begin, end);
+	}
+    }
+    wake_workers(js);
+
+    fn(ctx, 0, chunk < count ? chunk : count);
+
+    wait_for_jobs(js, &counter);
+}
+
+void count_job_perf(JobSystem *js) {
+    atomic_store_explicit(&js->count_perf, true, memory_order_relaxed);
+}
+
+void read_job_perf_counters(JobSystem *js, uint64_t values[COUNTERS]) {
+    for (int k = 0; k < COUNTERS; k++) {
+	values[k] = 0;
+	for (int i = 0; i < js->workers_count; i++) {
+	    values[k] += atomic_load_explicit(&js->workers[i].perf_totals[k], memory_order_relaxed);
+	}
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "perf_counters.h"
+
+typedef void (*JobFn)(void *ctx, int begin, int end);
+
+typedef struct {
+    atomic_int pending;
+} JobCounter;
+
+typedef struct JobSystem JobSystem;
+
+// Starts a fixed pool of threads. workers <= 0 uses one worker per online cpu.
+// The calling thread is worker 0: it runs jobs while it waits for them.
+JobSystem* init_job_system(int workers);
+
+void free_job_system(JobSystem *js);
+
+int job_system_workers(JobSystem *js);
+
+// Queues fn(ctx, begin, end). counter, if not NULL, is raised until the job
+// has finished. Jobs submitted from threads outside the pool, or with a NULL
+// job system, run immediately.
+void submit_job(JobSystem *js, JobFn fn, void *ctx, int begin, int end, JobCounter *counter);
+
+// Same as submit_job, but the job does not start before dependency drops to zero.
+void submit_job_after(JobSystem *js, JobCounter *dependency, JobFn fn, void *ctx, int begin, int end, JobCounter *counter);
+
+// Runs queued jobs until counter drops to zero.
+void wait_for_jobs(JobSystem *js, JobCounter *counter);
+
+// Calls fn over [0, count) split into ranges of at least grain items and
+// returns when all of them are done.
+void parallel_for(JobSystem *js, int count, int grain, JobFn fn, void *ctx);
+
+// Makes every worker but worker 0 count the hardware events of the jobs it
+// runs, in a counter group it opens on its next job. Worker 0 is left out:
+// its jobs are already seen by the counters of its own thread.
+void count_job_perf(JobSystem *js);
+
+// Counter totals of the jobs counted so far, summed over the workers.
+void read_job_perf_counters(JobSystem *js, uint64_t values[COUNTERS]);
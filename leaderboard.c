@@ -0,0 +1,54 @@
+#include "leaderboard.h"
+#include <assert.h>
+#include <string.h>
+
+bool read_score_entry(FILE *fp, ScoreEntry *e) {
+    // Spaces are part of the name, so only the line ending is skipped.
+    if (fscanf(fp, "%31[^,\n],%d", e->player, &e->score) != 2) {
+	return false;
+    }
+
+    int c;
+    while ((c = fgetc(fp)) != EOF && c != '\n') {
+    }
+    return true;
+}
+
+void write_score_entry(FILE *fp, const ScoreEntry *e) {
+    fprintf(fp, "%s,%d\n", e->player, e->score);
+}
+
+int compare_score_entries(const void *a, const void *b) {
+    const ScoreEntry *e1 = a;
+    const ScoreEntry *e2 = b;
+
+    if (e1->score != e2->score) {
+	return e1->score > e2->score ? -1 : 1;
+    }
+
+    return strcmp(e1->player, e2->player);
+}
+
+void append_score(const char *path, const char *player, int score) {
+    ScoreEntry e = {.score = score};
+
+    // Commas and newlines would break the csv format, the name is cut to what
+    // read_score_entry can read back.
+    int len = 0;
+    for (; player[len] != '\0' && len < LEADERBOARD_NAME_LEN - 1; len++) {
+	char c = player[len];
+	e.player[len] = (c == ',' || c == '\n') ? ' ' : c;
+    }
+    e.player[len] = '\0';
+
+    if (e.player[strspn(e.player, " \t")] == '\0') {
+	strcpy(e.player, "-");
+    }
+
+    FILE *fp = fopen(path, "a");
+    assert(fp != NULL && "Can't open winners file");
+
+    write_score_entry(fp, &e);
+
+    fclose(fp);
+}
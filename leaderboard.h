@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define LEADERBOARD_NAME_LEN 32
+
+typedef struct {
+    char player[LEADERBOARD_NAME_LEN];
+    int score;
+} ScoreEntry;
+
+bool read_score_entry(FILE *fp, ScoreEntry *e);
+
+void write_score_entry(FILE *fp, const ScoreEntry *e);
+
+// Highest score first, ties broken by player name so the order is total.
+int compare_score_entries(const void *a, const void *b);
+
+void append_score(const char *path, const char *player, int score);
@@ -1,187 +1,34 @@
 #include "include/raylib.h"
+#include "alloc.h"
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "asteroids.h"
+#include "histogram.h"
+#include "input.h"
+#include "jobs.h"
+#include "leaderboard.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "projectiles.h"
+#include "recorder.h"
+#include "sampler.h"
+#include "screen.h"
+#include "session.h"
+#include "ship.h"
+#include "timing.h"
+#include "trace.h"
+#include "world.h"
 
-#define MAX_ASTEROIDS 9
+#define TARGET_FPS 60
 
-typedef enum { MOVE_RIGHT, MOVE_UP, MOVE_LEFT, MOVE_DOWN } Direction;
-typedef enum { RIGHT, TOP, LEFT, BOTTOM } ScreenSide;
 typedef enum { GAME, GAME_OVER, WINNERS} GameScreen;
 
-typedef struct {
-    const int width;
-    const int height;
-} Screen;
-
-typedef struct {
-    Vector2 center;
-    Vector2 vertices[3];
-    float direction;
-    float max_radius;
-} Ship;
-
-typedef struct {
-    int score;
-    GameScreen game_screen;
-} Game;
-
-const Screen screen = {.width = 1800, .height = 1450};
-const float rotation_speed = 0.06;
-const float move_speed = 5;
-const float projectile_speed = 12;
-
-Ship init_ship(Vector2 center);
-
-void update_ship_vertices(Ship *ship) {
-    float l = (3 * PI) / 4;
-    float m = (5 * PI) / 4;
-
-    ship->vertices[0].x = ship->center.x + cos(ship->direction) * ship->max_radius;
-    ship->vertices[0].y = ship->center.y - sin(ship->direction) * ship->max_radius;
-
-    ship->vertices[1].x = ship->center.x + cos(ship->direction + l) * ship->max_radius;
-    ship->vertices[1].y = ship->center.y - sin(ship->direction + l) * ship->max_radius;
-
-    ship->vertices[2].x = ship->center.x + cos(ship->direction + m) * ship->max_radius;
-    ship->vertices[2].y = ship->center.y - sin(ship->direction + m) * ship->max_radius;
-}
-
-Ship init_ship(Vector2 center) {
-    Ship ship = {
-	.center = center,
-	.direction = 0.0,
-	.max_radius = 30,
-    };
-    update_ship_vertices(&ship);
-
-    return ship;
-}
-
-void move_ship(Ship *ship, float speed, Direction dir, Screen screen) {
-    switch (dir) {
-    case MOVE_LEFT:
-	ship->direction = fmod(ship->direction + speed, (2 * PI));
-	break;
-    case MOVE_RIGHT:
-	ship->direction = fmod(ship->direction - speed, (2 * PI));
-	break;
-    case MOVE_UP:
-	ship->center.x = ship->center.x + cos(ship->direction) * speed;
-	ship->center.y = ship->center.y - sin(ship->direction) * speed;
-	break;
-    case MOVE_DOWN:
-	ship->center.x = ship->center.x - cos(ship->direction) * speed;
-	ship->center.y = ship->center.y + sin(ship->direction) * speed;
-	break;
-    }
-
-    if (ship->center.x + ship->max_radius < 0) {
-	ship->center.x = screen.width + ship->max_radius - 1;
-    }
-
-    if (ship->center.x - ship->max_radius > screen.width) {
-	ship->center.x = 0 - ship->max_radius + 1;
-    }
-
-    if (ship->center.y + ship->max_radius < 0) {
-	ship->center.y = screen.height + ship->max_radius - 1;
-    }
-
-    if (ship->center.y - ship->max_radius > screen.height) {
-	ship->center.y = 0 - ship->max_radius;
-    }
-
-    update_ship_vertices(ship);
-}
-
-bool is_on_screen(Vector2 point, float radius, Screen screen) {
-    return point.x + radius >= 0 && point.x - radius <= screen.width &&
-	point.y + radius >= 0 && point.y - radius <= screen.height;
-}
-
-void move_projectile_forward(Projectile *p, float speed) {
-    p->center.x = p->center.x + cos(p->direction) * speed;
-    p->center.y = p->center.y - sin(p->direction) * speed;
-}
-
-bool check_projectile_asteroid_collision(Projectile *p, Asteroid* a) {
-    if (CheckCollisionCircles(p->center, p->radius, a->center, a->max_radius)) {	
-	if (CheckCollisionPointPoly(p->center, a->vector_coords, a->coords_size)) {
-	    return true;
-	}
-
-	Vector2 projectile_circle_points[] = {
-	    {p->center.x + p->radius, p->center.y},
-	    {p->center.x, p->center.y + p->radius},
-	    {p->center.x - p->radius, p->center.y},
-	    {p->center.x, p->center.y - p->radius}
-	};
-
-	for (int i = 0; i < sizeof(projectile_circle_points) / sizeof(Vector2); i++) {
-	    Vector2 v = projectile_circle_points[i];
-	    if (CheckCollisionPointPoly(v, a->vector_coords, a->coords_size)) {
-		return true;
-	    }	    
-	}
-    }
-    return false;
-}
-
-bool check_ship_asteroid_collision(Ship* ship, Asteroid* a) {
-    if (CheckCollisionCircles(ship->center, ship->max_radius, a->center, a->max_radius)) {
-	if (CheckCollisionPointTriangle(a->center, ship->vertices[0], ship->vertices[1], ship->vertices[2])) {
-	    return true;
-        }
-
-	for (int i = 0; i < a->coords_size; i++) {
-	    Vector2 v = a->vector_coords[i];
-            if (CheckCollisionPointTriangle(v, ship->vertices[0], ship->vertices[1], ship->vertices[2])) {
-		return true;
-            }
-        }
-
-        for (int i = 0; i < 3; i++) {
-            if (CheckCollisionPointPoly(ship->vertices[i], a->vector_coords, a->coords_size)) {
-		return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-bool check_two_asteroids_collision(Asteroid *a1, Asteroid* a2) {
-    if (CheckCollisionCircles(a1->center, a1->max_radius, a2->center, a2->max_radius)) {
-	for (int i = 0; i < a1->coords_size; i++) {
-	    Vector2 v = a1->vector_coords[i];
-	    if (CheckCollisionPointPoly(v, a2->vector_coords, a2->coords_size)) {		
-		return true;
-	    }
-	}
-
-	for (int i = 0; i < a2->coords_size; i++) {
-	    Vector2 v = a2->vector_coords[i];
-	    if (CheckCollisionPointPoly(v, a1->vector_coords, a1->coords_size)) {
-		return true;
-	    }
-	}
-    }
-
-    return false;
-}
-
-void draw_ship(Ship ship) {
-    DrawTriangleLines(ship.vertices[0], ship.vertices[1], ship.vertices[2], WHITE);
-}
-
 void draw_projectiles(ProjectilesVector v) {
     for (int i = 0; i < projectiles_vector_len(v); i++) {
-	Projectile* p = v[i];
+	Projectile* p = &v.items[i];
 	DrawCircleV(p->center, p->radius, RED);
     }
 }
@@ -200,6 +47,33 @@ void draw_info(int projectiles_count, int asteroids_count, int score) {
     DrawFPS(10, 130);
 }
 
+void draw_collision_counters(CollisionCounters *c, int x, int y) {
+    char line[96];
+    DrawText("collisions last tick: pairs / circle rejects / point tests / hits", x, y, 18, WHITE);
+    for (int t = 0; t < PAIR_TYPES; t++) {
+	PairCounters *p = &c->pairs[t];
+	snprintf(line, sizeof(line), "%s: %ld / %ld / %ld / %ld", pair_type_name(t),
+		 p->pairs, p->circle_rejects, p->point_tests, p->hits);
+	DrawText(line, x, y + 20 + t * 20, 18, WHITE);
+    }
+}
+
+void record_io(uint64_t ns) {
+    add_metric(METRIC_IO_OPERATIONS, 1);
+    add_metric(METRIC_IO_NS, ns);
+    max_metric(METRIC_IO_NS_MAX, ns);
+}
+
+void save_session(Session *s, const char *dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/session-%llu.bin", dir, (unsigned long long)s->seed);
+    if (write_session(path, s)) {
+	fprintf(stderr, "session: %d ticks written to %s\n", world_input_vector_len(s->inputs), path);
+    } else {
+	fprintf(stderr, "session: can't write %s\n", path);
+    }
+}
+
 void draw_game_over(Screen screen, char* player) {
     char* game_over = "Game Over";
     int game_over_font_size = 34;
@@ -224,24 +98,108 @@ void draw_game_over(Screen screen, char* player) {
 int main(void) {
     // Initialization
     //--------------------------------------------------------------------------------------
-    Game game = {
-        .score = 0,
-	.game_screen = GAME,
-    };
+    GameScreen game_screen = GAME;
+
+    // ASTEROIDS_SAMPLE=file.folded samples stacks ASTEROIDS_SAMPLE_HZ times per
+    // CPU second and writes them in the folded flame graph format at exit.
+    const char *sample_path = getenv("ASTEROIDS_SAMPLE");
+    const char *sample_hz = getenv("ASTEROIDS_SAMPLE_HZ");
+    if (sample_path != NULL &&
+	!start_sampler(sample_hz != NULL ? atoi(sample_hz) : DEFAULT_SAMPLER_HZ, DEFAULT_SAMPLER_SAMPLES)) {
+	fprintf(stderr, "Can't start the sampler\n");
+	sample_path = NULL;
+    }
+
+    // ASTEROIDS_TRACE=file.json records a trace, written at exit and on F4.
+    const char *trace_path = getenv("ASTEROIDS_TRACE");
+    if (trace_path != NULL) {
+	start_tracing(DEFAULT_TRACE_EVENTS);
+    }
 
-    Ship ship = init_ship((Vector2){500.0, 500.0});
+    World world;
+    uint64_t seed = now_ns();
+    init_world(&world, default_world_config(), seed);
 
-    ProjectilesVector projectiles = make_projectiles_vector(3);
+    // ASTEROIDS_SESSION=dir records the inputs of the game for bench_replay,
+    // written to dir/session-<seed>.bin when the game ends.
+    const char *session_dir = getenv("ASTEROIDS_SESSION");
+    Session session;
+    if (session_dir != NULL) {
+	init_session(&session, world.config, seed);
+    }
 
-    AsteroidsVector asteroids = make_asteroids_vector(MAX_ASTEROIDS);
+    Screen screen = world_screen(&world);
 
     int player_len = 0;
     char player[128];
     player[0] = '\0';
 
+    JobSystem* jobs = init_job_system(0);
+
     InitWindow(screen.width, screen.height, "Asteroids");
 
-    SetTargetFPS(60); // Set our game to run at 60 frames-per-second
+    // Input is pumped into the queue between frames instead of sleeping, see
+    // pump_input below. Frames still start every 1/TARGET_FPS second.
+    const uint64_t frame_ns = 1000000000 / TARGET_FPS;
+    uint64_t frame_deadline = now_ns() + frame_ns;
+
+    InputQueue input_queue;
+    init_input_queue(&input_queue);
+
+    InputPoller poller;
+    init_input_poller(&poller, &input_queue);
+
+    TickInput input;
+    init_tick_input(&input);
+
+    Profiler profiler;
+    init_profiler(&profiler);
+    world.profiler = &profiler;
+    bool show_profiler = false;
+
+    // ASTEROIDS_PERF=1 adds hardware counters per phase, reported at exit.
+    // The jobs of the other workers are counted with the phase they run in.
+    PerfCounters perf;
+    if (getenv("ASTEROIDS_PERF") != NULL && init_perf_counters(&perf)) {
+	profiler.perf = &perf;
+	profiler.perf_jobs = jobs;
+	count_job_perf(jobs);
+    }
+
+    // ASTEROIDS_HISTOGRAM=report.csv (or .json) writes frame and tick time
+    // percentiles at exit, and every ASTEROIDS_HISTOGRAM_INTERVAL seconds.
+    const char *histogram_path = getenv("ASTEROIDS_HISTOGRAM");
+    const char *interval = getenv("ASTEROIDS_HISTOGRAM_INTERVAL");
+    uint64_t report_ns = interval != NULL ? atof(interval) * 1e9 : 0;
+    uint64_t next_report = now_ns() + report_ns;
+
+    static Histogram frame_times;
+    static Histogram tick_times;
+    init_histogram(&frame_times);
+    init_histogram(&tick_times);
+    NamedHistogram histograms[] = {{"frame", &frame_times}, {"tick", &tick_times}};
+    uint64_t last_frame_start = 0;
+
+    // ASTEROIDS_FLIGHT=dir keeps the last ASTEROIDS_FLIGHT_SECONDS (5) of
+    // frames and dumps them when a frame takes more than
+    // ASTEROIDS_FLIGHT_BUDGET_MS, twice the frame time by default.
+    const char *flight_dir = getenv("ASTEROIDS_FLIGHT");
+    const char *flight_seconds = getenv("ASTEROIDS_FLIGHT_SECONDS");
+    const char *flight_budget = getenv("ASTEROIDS_FLIGHT_BUDGET_MS");
+    FlightRecorder recorder;
+    if (flight_dir != NULL) {
+	int seconds = flight_seconds != NULL ? atoi(flight_seconds) : 5;
+	uint64_t budget = flight_budget != NULL ? atof(flight_budget) * 1e6 : 2 * frame_ns;
+	init_flight_recorder(&recorder, world.config, flight_dir, budget, (seconds > 0 ? seconds : 1) * TARGET_FPS);
+    }
+
+    // ASTEROIDS_METRICS=file or unix:/path exports Prometheus metrics every
+    // ASTEROIDS_METRICS_INTERVAL seconds (10 by default) or on every scrape.
+    const char *metrics_target = getenv("ASTEROIDS_METRICS");
+    const char *metrics_interval = getenv("ASTEROIDS_METRICS_INTERVAL");
+    if (metrics_target != NULL) {
+	start_metrics(metrics_target, metrics_interval != NULL ? atof(metrics_interval) : 10);
+    }
     //--------------------------------------------------------------------------------------
 
     // Main game loop
@@ -249,148 +207,90 @@ int main(void) {
     {
 	// Update
 	//----------------------------------------------------------------------------------
-	switch (game.game_screen) {
-	case GAME: {
-	    if (IsKeyDown(KEY_LEFT)) {
-                move_ship(&ship, rotation_speed, MOVE_LEFT, screen);
-	    }
+	uint64_t frame_start = trace_begin();
+	uint64_t frame_time = now_ns();
+	FrameRecord frame_record = {.tick = world.tick};
+	if (last_frame_start != 0) {
+	    record_histogram(&frame_times, frame_time - last_frame_start);
+	    add_metric(METRIC_FRAMES, 1);
+	    add_metric(METRIC_FRAME_NS, frame_time - last_frame_start);
+	    max_metric(METRIC_FRAME_NS_MAX, frame_time - last_frame_start);
+	}
+	last_frame_start = frame_time;
 
-	    if (IsKeyDown(KEY_RIGHT)) {
-                move_ship(&ship, rotation_speed, MOVE_RIGHT, screen);
-	    }
+	if (histogram_path != NULL && report_ns > 0 && frame_time >= next_report) {
+	    write_histogram_report(histogram_path, histograms, 2);
+	    next_report = frame_time + report_ns;
+	}
 
-	    if (IsKeyDown(KEY_UP)) {
-                move_ship(&ship, move_speed, MOVE_UP, screen);
+	uint64_t t = begin_phase(&profiler);
+	collect_tick_input(&input_queue, &input, now_ns(), frame_ns);
+	for (int i = 0; i < input.typed_len; i++) {
+	    if (input.typed[i] == KEY_F3) {
+		show_profiler = !show_profiler;
 	    }
-
-	    if (IsKeyDown(KEY_DOWN)) {
-                move_ship(&ship, move_speed, MOVE_DOWN, screen);
+	    if (input.typed[i] == KEY_F4 && trace_path != NULL) {
+		write_trace(trace_path);
 	    }
+	}
+	end_phase(&profiler, PHASE_INPUT, t);
 
-	    if (IsKeyPressed(KEY_SPACE)) {
-		Projectile* p = make_projectile(ship.vertices[0], ship.direction);		
-		append_to_projectiles_vector(&projectiles, p);
+	switch (game_screen) {
+	case GAME: {
+	    uint64_t tick_start = now_ns();
+	    int score = world.score;
+	    WorldInput tick_input = world_input(&input);
+	    if (flight_dir != NULL) {
+		flight_recorder_before_tick(&recorder, &world);
 	    }
-	    
-	    for (int i = 0; i < projectiles_vector_len(projectiles); i++) {
-		Projectile* p = projectiles[i];
-		if (!is_on_screen(p->center, p->radius, screen)) {
-		    delete_from_projectiles_vector(projectiles, i);
-		    continue;
-		}
-		    
-		move_projectile_forward(p, projectile_speed);
+	    if (session_dir != NULL) {
+		record_session_tick(&session, tick_input);
 	    }
-
-	    for (int i = 0; i < asteroids_vector_len(asteroids); i++) {
-		Asteroid* a = asteroids[i];
-		if (!is_on_screen(a->center, a->max_radius, screen)) {
-		    delete_from_asteroids_vector(asteroids, i);
+	    frame_record.ticked = true;
+	    frame_record.input = tick_input;
+	    step_world(&world, jobs, tick_input);
+	    record_histogram(&tick_times, now_ns() - tick_start);
+
+	    add_metric(METRIC_TICKS, 1);
+	    add_metric(METRIC_SCORE, world.score - score);
+	    set_metric(METRIC_ASTEROIDS, asteroids_vector_len(world.asteroids));
+	    set_metric(METRIC_PROJECTILES, projectiles_vector_len(world.projectiles));
+
+	    if (world.game_over) {
+		add_metric(METRIC_GAMES, 1);
+		game_screen = GAME_OVER;
+		if (session_dir != NULL) {
+		    end_session(&session, &world);
+		    save_session(&session, session_dir);
 		}
 	    }
-	    
-	    bool asteroids_to_delete[asteroids_vector_len(asteroids)];
-	    for (int i = 0; i < asteroids_vector_len(asteroids); i++) {
-		asteroids_to_delete[i] = false;
-	    }
+	    break;
+	}
 
-	    bool projectiles_to_delete[projectiles_vector_len(projectiles)];
-	    for (int i = 0; i < projectiles_vector_len(projectiles); i++) {
-		projectiles_to_delete[i] = false;
-	    }
-	    
-	    for (int i = 0; i < asteroids_vector_len(asteroids); i++) {
-		Asteroid* a1 = asteroids[i];
-		if (check_ship_asteroid_collision(&ship, a1)) {
-		    game.game_screen = GAME_OVER;
-		    break;
-		}
+	case GAME_OVER: {
+	    for (int i = 0; i < input.typed_len && game_screen == GAME_OVER; i++) {
+		int key = input.typed[i];
+		if (key == KEY_ENTER) {
+		    player[player_len] = '\0';
+		    game_screen = WINNERS;
 
-		for (int j = 0; j < projectiles_vector_len(projectiles); j++) {
-		    Projectile* p = projectiles[j];
-		    if (check_projectile_asteroid_collision(p, a1)) {
-			asteroids_to_delete[i] = true;
-			projectiles_to_delete[j] = true;
-			game.score++;
-		    }
+		    uint64_t io_start = now_ns();
+		    append_score("./winners.csv", player, world.score);
+		    record_io(now_ns() - io_start);
 		}
 
-		for (int j = i + 1; j < asteroids_vector_len(asteroids); j++) {
-		    Asteroid* a2 = asteroids[j];
-		    if (check_two_asteroids_collision(a1, a2)) {
-			asteroids_to_delete[i] = true;
-			asteroids_to_delete[j] = true;	       
+		if (key == KEY_BACKSPACE) {
+		    if (player_len > 0) {
+			player_len--;
+			player[player_len] = '\0';
 		    }
 		}
-		move_asteroid(a1);	
-	    }
-	    
-	    for(int i = asteroids_vector_len(asteroids) - 1; i >= 0 ; i--) {
-		if (asteroids_to_delete[i] == true) {
-		    delete_from_asteroids_vector(asteroids, i);
-		}
-	    }
-	    for(int i = projectiles_vector_len(projectiles) - 1; i >= 0 ; i--) {
-		if (projectiles_to_delete[i] == true) {
-		    delete_from_projectiles_vector(projectiles, i);
-		}
-	    }
 
-	    if (asteroids_vector_len(asteroids) < asteroids_vector_cap(asteroids) && (GetRandomValue(0, 30) == 4)) {
-                Asteroid* a;
-                float direction;
-
-                switch (GetRandomValue(RIGHT, BOTTOM)) {	
-                case RIGHT:
-                    direction = GetRandomValue(90, 270) * DEG2RAD;
-                    a = init_asteroid(screen.width, GetRandomValue(0, screen.height), direction);
-                    break;
-                case TOP:
-                    direction = GetRandomValue(180, 360) * DEG2RAD;
-                    a = init_asteroid(GetRandomValue(180, 360), 0, direction);
-                    break;
-                case LEFT:
-                    direction = (GetRandomValue(270, 450) % 360) * DEG2RAD;
-                    a = init_asteroid(0, GetRandomValue(0, screen.height), direction);
-                    break;
-                case BOTTOM:
-                    direction = (GetRandomValue(270, 450) % 360) * DEG2RAD;
-                    a = init_asteroid(GetRandomValue(0, 180), screen.height, direction);
-                    break;
-                }
-
-		append_to_asteroids_vector(asteroids, a);
-	    }
-
-	    break;
-	}
-	case GAME_OVER: {
-	    int key = GetKeyPressed();
-	    if (key == KEY_ENTER) {
-		player[player_len] = '\0';
-		game.game_screen = WINNERS;
-
-		FILE* fp = fopen("./winners.csv", "a");
-		assert(fp != NULL && "Can't open winners file");
-
-		fseek(fp, 0, SEEK_END);
-
-		fprintf(fp, "%s,%d\n",  player, game.score);
-
-		fclose(fp);
-	    }
-
-	    if (key == KEY_BACKSPACE) {
-		if (player_len > 0) {
-		    player_len--;
-		    player[player_len] = '\0';
+		if ((key >= 32) && (key <= 126) && player_len < (int)sizeof(player) - 1) {
+		    player[player_len] = (char) key;
+		    player_len++;
 		}
 	    }
-
-	    if ((key >= 32) && (key <= 126)) {
-		player[player_len] = (char) key;
-		player_len++;
-	    }
 	    break;
 	}
 
@@ -402,30 +302,31 @@ int main(void) {
 
 	// Draw
 	//----------------------------------------------------------------------------------
+	t = begin_phase(&profiler);
 	BeginDrawing();
 
 	ClearBackground(DARKGRAY);
 
-	switch(game.game_screen) {
+	switch(game_screen) {
 	case GAME:
-	    draw_ship(ship);
+	    draw_ship(world.ship);
 
-	    draw_projectiles(projectiles);
+	    draw_projectiles(world.projectiles);
 
-	    for (int i = 0; i < asteroids_vector_len(asteroids); i++) {
-		draw_asteroid(asteroids[i]);
+	    for (int i = 0; i < asteroids_vector_len(world.asteroids); i++) {
+		draw_asteroid(&world.asteroids.items[i]);
 	    }
 
-	    draw_info(projectiles_vector_len(projectiles), asteroids_vector_len(asteroids), game.score);
+	    draw_info(projectiles_vector_len(world.projectiles), asteroids_vector_len(world.asteroids), world.score);
 	    break;
 	case GAME_OVER:
-	    draw_ship(ship);
+	    draw_ship(world.ship);
 
-	    for (int i = 0; i < asteroids_vector_len(asteroids); i++) {
-		draw_asteroid(asteroids[i]);
+	    for (int i = 0; i < asteroids_vector_len(world.asteroids); i++) {
+		draw_asteroid(&world.asteroids.items[i]);
 	    }
 
-	    //draw_info(projectiles_dq->count, asteroids_dq->count, game.score);
+	    //draw_info(projectiles_dq->count, asteroids_dq->count, world.score);
 
             draw_game_over(screen, player);
 	    break;
@@ -433,34 +334,110 @@ int main(void) {
 	case WINNERS: {
 	    int i = 0;
 
+	    uint64_t io_start = now_ns();
 	    FILE* fp = fopen("./winners.csv", "r+");
 	    assert(fp != NULL && "Can't open winners file");
 
-	    char player[32];
-	    int score;
+	    ScoreEntry e;
 
 	    char buffer[64];
 
-	    while (fscanf(fp, "%[^,],%d\n", player, &score) == 2) {
-		sprintf(buffer, "Player: %s - Score: %d\n", player, score);
+	    while (read_score_entry(fp, &e)) {
+		sprintf(buffer, "Player: %s - Score: %d\n", e.player, e.score);
 		DrawText(buffer, 400, 300 + i * 40, 35, GREEN);
 		i++;
 	    }
 
 	    fclose(fp);
+	    record_io(now_ns() - io_start);
 	    break;
 	}
 	}
 
+	if (show_profiler) {
+	    draw_profiler(&profiler, 10, 180);
+	    draw_collision_counters(&world.collisions, 10, 360);
+	}
+
+	end_phase(&profiler, PHASE_DRAW, t);
+	t = begin_phase(&profiler);
 	EndDrawing();
+	end_phase(&profiler, PHASE_SWAP, t);
+	end_profiler_frame(&profiler);
+
+	if (flight_dir != NULL) {
+	    // Timed up to here, so the record holds the time its phases add up
+	    // to and not the one of the frame before.
+	    frame_record.frame_ns = now_ns() - frame_time;
+	    last_frame_phases(&profiler, frame_record.phases);
+	    frame_record.asteroids = asteroids_vector_len(world.asteroids);
+	    frame_record.projectiles = projectiles_vector_len(world.projectiles);
+	    record_flight_frame(&recorder, &frame_record);
+	}
+
+	// EndDrawing polled the events of the frame, pick them up before the
+	// pump polls again and raylib forgets them.
+	poll_input(&poller);
+	pump_input(&poller, frame_deadline);
+	AllocCount allocs = end_alloc_frame();
+	add_metric(METRIC_ALLOCATIONS, allocs.allocs);
+	add_metric(METRIC_ALLOCATED_BYTES, allocs.bytes);
+	trace_end("frame", frame_start);
+
+	frame_deadline += frame_ns;
+	if (frame_deadline < now_ns()) {
+	    frame_deadline = now_ns() + frame_ns;
+	}
 	//----------------------------------------------------------------------------------
     }
 
     // De-Initialization
     //--------------------------------------------------------------------------------------
+    if (sample_path != NULL && !stop_sampler(sample_path)) {
+	fprintf(stderr, "Can't write samples to %s\n", sample_path);
+    }
+
     CloseWindow(); // Close window and OpenGL context
+    stop_metrics();
     //--------------------------------------------------------------------------------------
     // free memory
+#ifdef TRACK_ALLOCS
+    // Goes with the report_allocs output below, the world is gone by then.
+    fprintf(stderr, "frame arena peak: %zu of %zu bytes\n", arena_peak(&world.frame_arena),
+	    world.frame_arena.high_water);
+#endif
+    if (flight_dir != NULL) {
+	free_flight_recorder(&recorder);
+    }
+    if (session_dir != NULL) {
+	// A game left before it ended is kept too.
+	if (!world.game_over) {
+	    end_session(&session, &world);
+	    save_session(&session, session_dir);
+	}
+	free_session(&session);
+    }
+    free_world(&world);
+    free_job_system(jobs);
+
+    if (profiler.perf != NULL) {
+	printf("hardware counters per phase scope:\n");
+	write_perf_report(&profiler, stdout);
+	free_perf_counters(&perf);
+    }
+
+    if (histogram_path != NULL && !write_histogram_report(histogram_path, histograms, 2)) {
+	fprintf(stderr, "Can't write histogram report to %s\n", histogram_path);
+    }
+
+    if (trace_path != NULL) {
+	if (!write_trace(trace_path)) {
+	    fprintf(stderr, "Can't write trace to %s\n", trace_path);
+	}
+	stop_tracing();
+    }
+
+    report_allocs(stderr);
 
     return 0;
 }
@@ -0,0 +1,272 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "leaderboard.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Merges many winners.csv files into one sorted leaderboard without holding
+// all of them in memory: inputs are cut into sorted runs of at most run_size
+// entries that are spilled to temporary files, then the runs are merged
+// fan_in at a time until a single run remains.
+
+typedef struct {
+    FILE *fp;
+    ScoreEntry head;
+} Run;
+
+typedef struct {
+    FILE **files;
+    int len;
+    int cap;
+} RunList;
+
+typedef struct {
+    long run_size;
+    int fan_in;
+    const char *tmp_dir;
+} MergeOptions;
+
+static FILE *open_spill_file(const MergeOptions *opts) {
+    if (opts->tmp_dir == NULL) {
+	return tmpfile();
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/merge_scores_XXXXXX", opts->tmp_dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+	return NULL;
+    }
+    unlink(path);
+
+    return fdopen(fd, "w+");
+}
+
+static void append_run(RunList *runs, FILE *fp) {
+    if (runs->len == runs->cap) {
+	runs->cap = runs->cap == 0 ? 16 : runs->cap * 2;
+	runs->files = realloc(runs->files, sizeof(FILE *) * runs->cap);
+	assert(runs->files != NULL && "Can't allocate run list");
+    }
+    runs->files[runs->len++] = fp;
+}
+
+static bool same_entry(const ScoreEntry *a, const ScoreEntry *b) {
+    return a->score == b->score && strcmp(a->player, b->player) == 0;
+}
+
+static bool spill_run(RunList *runs, ScoreEntry *entries, long len, const MergeOptions *opts) {
+    qsort(entries, len, sizeof(ScoreEntry), compare_score_entries);
+
+    FILE *fp = open_spill_file(opts);
+    if (fp == NULL) {
+	perror("merge_scores: can't create spill file");
+	return false;
+    }
+
+    for (long i = 0; i < len; i++) {
+	if (i > 0 && same_entry(&entries[i], &entries[i - 1])) {
+	    continue;
+	}
+	write_score_entry(fp, &entries[i]);
+    }
+
+    rewind(fp);
+    append_run(runs, fp);
+    return true;
+}
+
+// Binary min-heap of runs ordered by their current head entry.
+static void sift_down(Run **heap, int len, int i) {
+    for (;;) {
+	int smallest = i;
+	int l = 2 * i + 1;
+	int r = 2 * i + 2;
+
+	if (l < len && compare_score_entries(&heap[l]->head, &heap[smallest]->head) < 0) {
+	    smallest = l;
+	}
+	if (r < len && compare_score_entries(&heap[r]->head, &heap[smallest]->head) < 0) {
+	    smallest = r;
+	}
+	if (smallest == i) {
+	    return;
+	}
+
+	Run *t = heap[i];
+	heap[i] = heap[smallest];
+	heap[smallest] = t;
+	i = smallest;
+    }
+}
+
+// Merges `count` sorted runs into `out`, dropping duplicate entries, and
+// closes the runs. No runs, as with only empty inputs, leave `out` empty.
+static void merge_runs(FILE **files, int count, FILE *out) {
+    if (count == 0) {
+	return;
+    }
+
+    Run *runs = malloc(sizeof(Run) * count);
+    Run **heap = malloc(sizeof(Run *) * count);
+    assert(runs != NULL && heap != NULL && "Can't allocate merge heap");
+
+    int heap_len = 0;
+    for (int i = 0; i < count; i++) {
+	runs[i].fp = files[i];
+	if (read_score_entry(runs[i].fp, &runs[i].head)) {
+	    heap[heap_len++] = &runs[i];
+	}
+    }
+
+    for (int i = heap_len / 2 - 1; i >= 0; i--) {
+	sift_down(heap, heap_len, i);
+    }
+
+    bool has_last = false;
+    ScoreEntry last;
+
+    while (heap_len > 0) {
+	Run *r = heap[0];
+
+	if (!has_last || !same_entry(&last, &r->head)) {
+	    write_score_entry(out, &r->head);
+	    last = r->head;
+	    has_last = true;
+	}
+
+	if (!read_score_entry(r->fp, &r->head)) {
+	    heap[0] = heap[--heap_len];
+	}
+	sift_down(heap, heap_len, 0);
+    }
+
+    for (int i = 0; i < count; i++) {
+	fclose(runs[i].fp);
+    }
+
+    free(heap);
+    free(runs);
+}
+
+static void usage(void) {
+    fprintf(stderr,
+	    "usage: merge_scores [-r run_size] [-k fan_in] [-t tmp_dir] [-o output] file...\n");
+}
+
+int main(int argc, char **argv) {
+    MergeOptions opts = {
+	.run_size = 1 << 20,
+	.fan_in = 16,
+	.tmp_dir = NULL,
+    };
+    const char *output = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:k:t:o:")) != -1) {
+	switch (opt) {
+	case 'r':
+	    opts.run_size = atol(optarg);
+	    break;
+	case 'k':
+	    opts.fan_in = atoi(optarg);
+	    break;
+	case 't':
+	    opts.tmp_dir = optarg;
+	    break;
+	case 'o':
+	    output = optarg;
+	    break;
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+
+    if (optind >= argc || opts.run_size < 1 || opts.fan_in < 2) {
+	usage();
+	return 1;
+    }
+
+    ScoreEntry *entries = malloc(sizeof(ScoreEntry) * opts.run_size);
+    assert(entries != NULL && "Can't allocate run buffer");
+
+    RunList runs = {0};
+    long len = 0;
+
+    for (int i = optind; i < argc; i++) {
+	FILE *fp = fopen(argv[i], "r");
+	if (fp == NULL) {
+	    fprintf(stderr, "merge_scores: can't open %s\n", argv[i]);
+	    return 1;
+	}
+
+	for (;;) {
+	    if (read_score_entry(fp, &entries[len])) {
+		len++;
+		if (len == opts.run_size) {
+		    if (!spill_run(&runs, entries, len, &opts)) {
+			return 1;
+		    }
+		    len = 0;
+		}
+		continue;
+	    }
+
+	    if (feof(fp)) {
+		break;
+	    }
+
+	    fprintf(stderr, "merge_scores: skipping malformed entry in %s\n", argv[i]);
+	    int c;
+	    while ((c = fgetc(fp)) != EOF && c != '\n') {
+	    }
+	}
+	fclose(fp);
+    }
+
+    if (len > 0 && !spill_run(&runs, entries, len, &opts)) {
+	return 1;
+    }
+    free(entries);
+
+    // Intermediate passes, each one cuts the number of runs by fan_in.
+    while (runs.len > opts.fan_in) {
+	RunList next = {0};
+
+	for (int i = 0; i < runs.len; i += opts.fan_in) {
+	    int count = runs.len - i < opts.fan_in ? runs.len - i : opts.fan_in;
+
+	    FILE *fp = open_spill_file(&opts);
+	    if (fp == NULL) {
+		perror("merge_scores: can't create spill file");
+		return 1;
+	    }
+
+	    merge_runs(runs.files + i, count, fp);
+	    rewind(fp);
+	    append_run(&next, fp);
+	}
+
+	free(runs.files);
+	runs = next;
+    }
+
+    FILE *out = output == NULL ? stdout : fopen(output, "w");
+    if (out == NULL) {
+	fprintf(stderr, "merge_scores: can't open %s\n", output);
+	return 1;
+    }
+
+    merge_runs(runs.files, runs.len, out);
+
+    if (out != stdout) {
+	fclose(out);
+    }
+    free(runs.files);
+
+    return 0;
+}
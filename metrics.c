@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+#include "timing.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define METRICS_SOCKET_PREFIX "unix:"
+#define POLL_MS 100
+
+// INTERVAL_MAX is exported as a gauge and reset by every export.
+typedef enum { COUNTER, GAUGE, INTERVAL_MAX } MetricType;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    MetricType type;
+    double scale; // exported value is the raw value times scale
+} MetricInfo;
+
+static const MetricInfo metric_info[METRICS] = {
+    [METRIC_FRAMES] = {"asteroids_frames_total", "Frames drawn.", COUNTER, 1},
+    [METRIC_FRAME_NS] = {"asteroids_frame_seconds_total", "Time between frame starts, summed.", COUNTER, 1e-9},
+    [METRIC_FRAME_NS_MAX] = {"asteroids_frame_seconds_max", "Longest frame since the previous export.", INTERVAL_MAX, 1e-9},
+    [METRIC_TICKS] = {"asteroids_ticks_total", "Simulation ticks.", COUNTER, 1},
+    [METRIC_ASTEROIDS] = {"asteroids_asteroids", "Live asteroids.", GAUGE, 1},
+    [METRIC_PROJECTILES] = {"asteroids_projectiles", "Live projectiles.", GAUGE, 1},
+    [METRIC_SCORE] = {"asteroids_score_total", "Points scored.", COUNTER, 1},
+    [METRIC_GAMES] = {"asteroids_games_total", "Games finished.", COUNTER, 1},
+    [METRIC_ALLOCATIONS] = {"asteroids_allocations_total", "Heap allocations, with TRACK_ALLOCS only.", COUNTER, 1},
+    [METRIC_ALLOCATED_BYTES] = {"asteroids_allocated_bytes_total", "Heap bytes allocated, with TRACK_ALLOCS only.", COUNTER, 1},
+    [METRIC_IO_OPERATIONS] = {"asteroids_io_operations_total", "Score file reads and writes.", COUNTER, 1},
+    [METRIC_IO_NS] = {"asteroids_io_seconds_total", "Time spent in score file I/O.", COUNTER, 1e-9},
+    [METRIC_IO_NS_MAX] = {"asteroids_io_seconds_max", "Slowest score file I/O since the previous export.", INTERVAL_MAX, 1e-9},
+};
+
+static atomic_uint_fast64_t values[METRICS];
+
+static struct {
+    pthread_t thread;
+    atomic_bool stop;
+    bool running;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    int socket; // -1 when writing to a file
+    uint64_t interval_ns;
+} exporter;
+
+void add_metric(MetricId id, uint64_t value) {
+    atomic_fetch_add_explicit(&values[id], value, memory_order_relaxed);
+}
+
+void set_metric(MetricId id, uint64_t value) {
+    atomic_store_explicit(&values[id], value, memory_order_relaxed);
+}
+
+void max_metric(MetricId id, uint64_t value) {
+    uint64_t current = atomic_load_explicit(&values[id], memory_order_relaxed);
+    while (value > current &&
+	   !atomic_compare_exchange_weak_explicit(&values[id], &current, value, memory_order_relaxed,
+						  memory_order_relaxed)) {
+    }
+}
+
+static void write_metrics(FILE *f) {
+    for (int i = 0; i < METRICS; i++) {
+	const MetricInfo *m = &metric_info[i];
+	uint64_t v = atomic_load_explicit(&values[i], memory_order_relaxed);
+	if (m->type == INTERVAL_MAX) {
+	    v = atomic_exchange_explicit(&values[i], 0, memory_order_relaxed);
+	}
+
+	fprintf(f, "# HELP %s %s\n", m->name, m->help);
+	fprintf(f, "# TYPE %s %s\n", m->name, m->type == COUNTER ? "counter" : "gauge");
+	fprintf(f, "%s %.9g\n", m->name, v * m->scale);
+    }
+}
+
+// Written next to the target and renamed, so readers never see half a file.
+static void export_to_file(void) {
+    char tmp[sizeof(exporter.path) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", exporter.path);
+
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL) {
+	return;
+    }
+    write_metrics(f);
+    if (fclose(f) == 0) {
+	rename(tmp, exporter.path);
+    }
+}
+
+// MSG_NOSIGNAL: a scraper that hung up must not kill the game with SIGPIPE.
+static bool send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+	ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+	if (sent < 0) {
+	    if (errno == EINTR) {
+		continue;
+	    }
+	    if (errno != EPIPE && errno != ECONNRESET) {
+		perror("metrics");
+	    }
+	    return false;
+	}
+	data += sent;
+	len -= sent;
+    }
+    return true;
+}
+
+static void serve_connection(int fd) {
+    // The request doesn't matter, every path returns the metrics.
+    char request[1024];
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    if (poll(&pfd, 1, POLL_MS) > 0) {
+	if (read(fd, request, sizeof(request)) < 0) {
+	    return;
+	}
+    }
+
+    char *body = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&body, &len);
+    if (f == NULL) {
+	return;
+    }
+    write_metrics(f);
+    fflush(f);
+    size_t body_len = len;
+
+    // The header goes after the body in the buffer, its length needs the body.
+    fprintf(f, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+	    body_len);
+    fclose(f);
+
+    if (send_all(fd, body + body_len, len - body_len)) {
+	send_all(fd, body, body_len);
+    }
+    free(body);
+}
+
+static void *exporter_main(void *arg) {
+    uint64_t next = now_ns();
+
+    while (!atomic_load(&exporter.stop)) {
+	if (exporter.socket >= 0) {
+	    struct pollfd pfd = {.fd = exporter.socket, .events = POLLIN};
+	    if (poll(&pfd, 1, POLL_MS) > 0) {
+		int fd = accept(exporter.socket, NULL, NULL);
+		if (fd >= 0) {
+		    serve_connection(fd);
+		    close(fd);
+		}
+	    }
+	} else if (now_ns() >= next) {
+	    export_to_file();
+	    next = now_ns() + exporter.interval_ns;
+	} else {
+	    sleep_ns(POLL_MS * 1000000ull);
+	}
+    }
+
+    if (exporter.socket < 0) {
+	export_to_file();
+    }
+    return NULL;
+}
+
+static int listen_on(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+	return -1;
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+	close(fd);
+	return -1;
+    }
+    return fd;
+}
+
+bool start_metrics(const char *target, double interval_s) {
+    bool serve = strncmp(target, METRICS_SOCKET_PREFIX, strlen(METRICS_SOCKET_PREFIX)) == 0;
+    const char *path = serve ? target + strlen(METRICS_SOCKET_PREFIX) : target;
+    if (strlen(path) >= sizeof(exporter.path)) {
+	fprintf(stderr, "metrics: path too long: %s\n", path);
+	return false;
+    }
+
+    strcpy(exporter.path, path);
+    exporter.interval_ns = interval_s * 1e9;
+    exporter.socket = -1;
+    atomic_store(&exporter.stop, false);
+
+    if (serve) {
+	exporter.socket = listen_on(path);
+	if (exporter.socket < 0) {
+	    perror("metrics");
+	    return false;
+	}
+    }
+
+    if (pthread_create(&exporter.thread, NULL, exporter_main, NULL) != 0) {
+	if (exporter.socket >= 0) {
+	    close(exporter.socket);
+	    unlink(exporter.path);
+	}
+	return false;
+    }
+
+    exporter.running = true;
+    return true;
+}
+
+void stop_metrics(void) {
+    if (!exporter.running) {
+	return;
+    }
+
+    atomic_store(&exporter.stop, true);
+    pthread_join(exporter.thread, NULL);
+    exporter.running = false;
+
+    if (exporter.socket >= 0) {
+	close(exporter.socket);
+	unlink(exporter.path);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Process-wide counters and gauges for monitoring, exported in the
+// Prometheus text format by a background thread. The game loop only does
+// relaxed atomic updates; the exporter reads whatever values are current.
+
+typedef enum {
+    METRIC_FRAMES,
+    METRIC_FRAME_NS,
+    METRIC_FRAME_NS_MAX,
+    METRIC_TICKS,
+    METRIC_ASTEROIDS,
+    METRIC_PROJECTILES,
+    METRIC_SCORE,
+    METRIC_GAMES,
+    METRIC_ALLOCATIONS,
+    METRIC_ALLOCATED_BYTES,
+    METRIC_IO_OPERATIONS,
+    METRIC_IO_NS,
+    METRIC_IO_NS_MAX,
+    METRICS,
+} MetricId;
+
+void add_metric(MetricId id, uint64_t value);
+
+void set_metric(MetricId id, uint64_t value);
+
+// Raises a maximum, the exporter resets it after every export so it covers
+// one interval.
+void max_metric(MetricId id, uint64_t value);
+
+// target is a file rewritten every interval_s seconds, or unix:/path to
+// serve every connection on a Unix domain socket (curl --unix-socket works).
+bool start_metrics(const char *target, double interval_s);
+
+void stop_metrics(void);
@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+
+#include "perf_counters.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *counter_names[COUNTERS] = {
+    [COUNTER_CYCLES] = "cycles",
+    [COUNTER_INSTRUCTIONS] = "instructions",
+    [COUNTER_L1D_MISSES] = "l1d_misses",
+    [COUNTER_LLC_MISSES] = "llc_misses",
+    [COUNTER_BRANCH_MISSES] = "branch_misses",
+};
+
+const char *counter_name(CounterKind kind) {
+    return counter_names[kind];
+}
+
+bool perf_counter_available(PerfCounters *pc, CounterKind kind) {
+    return pc->slots[kind] >= 0;
+}
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} counter_events[COUNTERS] = {
+    [COUNTER_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [COUNTER_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [COUNTER_L1D_MISSES] = {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+					       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    [COUNTER_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [COUNTER_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+bool init_perf_counters(PerfCounters *pc) {
+    int leader = -1;
+    int error = 0;
+    pc->count = 0;
+
+    for (int k = 0; k < COUNTERS; k++) {
+	pc->fds[k] = -1;
+	pc->slots[k] = -1;
+
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = counter_events[k].type;
+	attr.config = counter_events[k].config;
+	attr.read_format = PERF_FORMAT_GROUP;
+	attr.disabled = leader == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+	if (fd < 0) {
+	    error = errno;
+	    continue;
+	}
+
+	if (leader == -1) {
+	    leader = fd;
+	}
+	pc->fds[k] = fd;
+	pc->slots[k] = pc->count++;
+    }
+
+    if (leader == -1) {
+	fprintf(stderr, "perf counters unavailable: %s\n", strerror(error));
+	return false;
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void free_perf_counters(PerfCounters *pc) {
+    // Members first, the leader is the first open counter.
+    for (int k = COUNTERS - 1; k >= 0; k--) {
+	if (pc->fds[k] >= 0) {
+	    close(pc->fds[k]);
+	}
+    }
+    pc->count = 0;
+}
+
+void read_perf_counters(PerfCounters *pc, uint64_t values[COUNTERS]) {
+    uint64_t group[COUNTERS + 1] = {0};
+    int leader = -1;
+    for (int k = 0; k < COUNTERS && leader == -1; k++) {
+	leader = pc->fds[k];
+    }
+
+    if (leader < 0 || read(leader, group, sizeof(uint64_t) * (pc->count + 1)) <= 0) {
+	memset(values, 0, sizeof(uint64_t) * COUNTERS);
+	return;
+    }
+
+    // group[0] is the number of counters, then one value per counter.
+    for (int k = 0; k < COUNTERS; k++) {
+	values[k] = pc->slots[k] >= 0 ? group[1 + pc->slots[k]] : 0;
+    }
+}
+
+#else
+
+bool init_perf_counters(PerfCounters *pc) {
+    for (int k = 0; k < COUNTERS; k++) {
+	pc->fds[k] = -1;
+	pc->slots[k] = -1;
+    }
+    pc->count = 0;
+    fprintf(stderr, "perf counters unavailable: not supported on this platform\n");
+    return false;
+}
+
+void free_perf_counters(PerfCounters *pc) {
+    pc->count = 0;
+}
+
+void read_perf_counters(PerfCounters *pc, uint64_t values[COUNTERS]) {
+    memset(values, 0, sizeof(uint64_t) * COUNTERS);
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hardware counters of the calling thread, read as one perf_event_open
+// group. Counters the kernel or the machine doesn't allow are left out, and
+// when none of them can be opened the group is simply unavailable: the
+// game runs the same without it.
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTERS,
+} CounterKind;
+
+typedef struct {
+    int fds[COUNTERS];
+    int slots[COUNTERS]; // position in the group read, -1 when not counting
+    int count;
+} PerfCounters;
+
+// Returns false and prints why when no counter could be opened.
+bool init_perf_counters(PerfCounters *pc);
+
+void free_perf_counters(PerfCounters *pc);
+
+// Current value of every counter, 0 for the ones that aren't counting.
+void read_perf_counters(PerfCounters *pc, uint64_t values[COUNTERS]);
+
+bool perf_counter_available(PerfCounters *pc, CounterKind kind);
+
+const char *counter_name(CounterKind kind);
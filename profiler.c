@@ -0,0 +1,203 @@
+#include "profiler.h"
+#include "include/raylib.h"
+#include "timing.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAPH_HEIGHT 160
+#define GRAPH_NS_PER_PIXEL 125000 // the graph shows up to 20 ms
+#define BAR_WIDTH 2
+#define FRAME_BUDGET_NS 16666667
+#define STATS_COLUMN 90
+
+static const char *phase_names[PHASES] = {
+    [PHASE_INPUT] = "input",
+    [PHASE_PROJECTILES] = "projectiles",
+    [PHASE_CULL] = "cull",
+    [PHASE_COLLISION] = "collision",
+    [PHASE_MOVE] = "move",
+    [PHASE_DELETE] = "delete",
+    [PHASE_SPAWN] = "spawn",
+    [PHASE_DRAW] = "draw",
+    [PHASE_SWAP] = "swap",
+};
+
+void init_profiler(Profiler *p) {
+    memset(p, 0, sizeof(Profiler));
+}
+
+const char *phase_name(Phase phase) {
+    return phase_names[phase];
+}
+
+static void read_phase_counters(Profiler *p, uint64_t values[COUNTERS]) {
+    read_perf_counters(p->perf, values);
+    if (p->perf_jobs != NULL) {
+	uint64_t jobs[COUNTERS];
+	read_job_perf_counters(p->perf_jobs, jobs);
+	for (int k = 0; k < COUNTERS; k++) {
+	    values[k] += jobs[k];
+	}
+    }
+}
+
+uint64_t begin_phase(Profiler *p) {
+    if (p != NULL && p->perf != NULL) {
+	read_phase_counters(p, p->perf_open);
+    }
+    return p != NULL || tracing_enabled() ? now_ns() : 0;
+}
+
+void end_phase(Profiler *p, Phase phase, uint64_t start) {
+    if (p == NULL && !tracing_enabled()) {
+	return;
+    }
+
+    uint64_t end = now_ns();
+    if (p != NULL) {
+	p->frame[phase] += end - start;
+    }
+
+    if (p != NULL && p->perf != NULL) {
+	uint64_t values[COUNTERS];
+	read_phase_counters(p, values);
+	for (int k = 0; k < COUNTERS; k++) {
+	    p->perf_totals[phase][k] += values[k] - p->perf_open[k];
+	}
+	p->perf_scopes[phase]++;
+    }
+    trace_event(phase_names[phase], start, end);
+}
+
+void end_profiler_frame(Profiler *p) {
+    memcpy(p->samples[p->next], p->frame, sizeof(p->frame));
+    memset(p->frame, 0, sizeof(p->frame));
+
+    p->next = (p->next + 1) % PROFILER_WINDOW;
+    if (p->count < PROFILER_WINDOW) {
+	p->count++;
+    }
+}
+
+void last_frame_phases(Profiler *p, uint64_t phases[PHASES]) {
+    int slot = (p->next - 1 + PROFILER_WINDOW) % PROFILER_WINDOW;
+    memcpy(phases, p->samples[slot], sizeof(uint64_t) * PHASES);
+}
+
+static int compare_ns(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+PhaseStats phase_stats(Profiler *p, Phase phase) {
+    PhaseStats s = {0};
+    if (p->count == 0) {
+	return s;
+    }
+
+    uint64_t sorted[PROFILER_WINDOW];
+    uint64_t sum = 0;
+    for (int i = 0; i < p->count; i++) {
+	sorted[i] = p->samples[i][phase];
+	sum += sorted[i];
+    }
+    qsort(sorted, p->count, sizeof(uint64_t), compare_ns);
+
+    s.min = sorted[0];
+    s.max = sorted[p->count - 1];
+    s.avg = sum / p->count;
+    s.p99 = sorted[(p->count - 1) * 99 / 100];
+    return s;
+}
+
+void write_perf_report(Profiler *p, FILE *f) {
+    if (p->perf == NULL) {
+	return;
+    }
+
+    fprintf(f, "%-12s %8s", "phase", "scopes");
+    for (int k = 0; k < COUNTERS; k++) {
+	fprintf(f, " %14s", counter_name(k));
+    }
+    fprintf(f, " %6s\n", "ipc");
+
+    for (int phase = 0; phase < PHASES; phase++) {
+	long scopes = p->perf_scopes[phase];
+	fprintf(f, "%-12s %8ld", phase_names[phase], scopes);
+
+	for (int k = 0; k < COUNTERS; k++) {
+	    if (!perf_counter_available(p->perf, k)) {
+		fprintf(f, " %14s", "n/a");
+	    } else {
+		fprintf(f, " %14.0f", scopes > 0 ? (double)p->perf_totals[phase][k] / scopes : 0.0);
+	    }
+	}
+
+	uint64_t cycles = p->perf_totals[phase][COUNTER_CYCLES];
+	uint64_t instructions = p->perf_totals[phase][COUNTER_INSTRUCTIONS];
+	if (cycles > 0 && perf_counter_available(p->perf, COUNTER_INSTRUCTIONS)) {
+	    fprintf(f, " %6.2f\n", (double)instructions / cycles);
+	} else {
+	    fprintf(f, " %6s\n", "n/a");
+	}
+    }
+}
+
+void draw_profiler(Profiler *p, int x, int y) {
+    const Color phase_colors[PHASES] = {
+	[PHASE_INPUT] = SKYBLUE,
+	[PHASE_PROJECTILES] = RED,
+	[PHASE_CULL] = ORANGE,
+	[PHASE_COLLISION] = YELLOW,
+	[PHASE_MOVE] = GREEN,
+	[PHASE_DELETE] = PINK,
+	[PHASE_SPAWN] = PURPLE,
+	[PHASE_DRAW] = BLUE,
+	[PHASE_SWAP] = LIGHTGRAY,
+    };
+
+    int width = PROFILER_WINDOW * BAR_WIDTH;
+    DrawRectangle(x, y, width, GRAPH_HEIGHT, Fade(BLACK, 0.6));
+
+    // Oldest frame on the left.
+    for (int i = 0; i < p->count; i++) {
+	int slot = (p->next - p->count + i + PROFILER_WINDOW) % PROFILER_WINDOW;
+	int bottom = y + GRAPH_HEIGHT;
+
+	for (int phase = 0; phase < PHASES && bottom > y; phase++) {
+	    int height = p->samples[slot][phase] / GRAPH_NS_PER_PIXEL;
+	    if (height > bottom - y) {
+		height = bottom - y;
+	    }
+	    bottom -= height;
+	    DrawRectangle(x + i * BAR_WIDTH, bottom, BAR_WIDTH, height, phase_colors[phase]);
+	}
+    }
+
+    // Line at the 60 FPS frame budget.
+    int budget_y = y + GRAPH_HEIGHT - FRAME_BUDGET_NS / GRAPH_NS_PER_PIXEL;
+    DrawLine(x, budget_y, x + width, budget_y, WHITE);
+
+    static const char *columns[] = {"min ms", "avg ms", "max ms", "p99 ms"};
+    int text_x = x + width + 10;
+    for (int c = 0; c < 4; c++) {
+	DrawText(columns[c], text_x + (c + 2) * STATS_COLUMN, y, 18, WHITE);
+    }
+
+    char number[16];
+    for (int phase = 0; phase < PHASES; phase++) {
+	PhaseStats s = phase_stats(p, phase);
+	uint64_t values[] = {s.min, s.avg, s.max, s.p99};
+	int line_y = y + 20 + phase * 20;
+
+	DrawRectangle(text_x, line_y + 2, 14, 14, phase_colors[phase]);
+	DrawText(phase_names[phase], text_x + 20, line_y, 18, WHITE);
+	for (int c = 0; c < 4; c++) {
+	    snprintf(number, sizeof(number), "%.3f", values[c] / 1e6);
+	    DrawText(number, text_x + (c + 2) * STATS_COLUMN, line_y, 18, WHITE);
+	}
+    }
+}
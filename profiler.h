@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "jobs.h"
+#include "perf_counters.h"
+
+// Frames kept for the rolling statistics, about four seconds at 60 FPS.
+#define PROFILER_WINDOW 240
+
+typedef enum {
+    PHASE_INPUT,
+    PHASE_PROJECTILES,
+    PHASE_CULL,
+    PHASE_COLLISION,
+    PHASE_MOVE,
+    PHASE_DELETE,
+    PHASE_SPAWN,
+    PHASE_DRAW,
+    PHASE_SWAP,
+    PHASES,
+} Phase;
+
+// Wall time of every phase of the last PROFILER_WINDOW frames. A phase can
+// be entered several times per frame, its time is the sum. Not thread safe:
+// a profiler belongs to the thread running the frame.
+typedef struct {
+    uint64_t frame[PHASES];
+    uint64_t samples[PROFILER_WINDOW][PHASES];
+    int next; // slot of the next finished frame
+    int count;
+
+    // Optional hardware counters, summed per phase over the whole run. They
+    // count the profiling thread, plus the jobs run by the other workers of
+    // perf_jobs during the phase when it is set, see count_job_perf.
+    PerfCounters *perf;
+    JobSystem *perf_jobs;
+    uint64_t perf_open[COUNTERS];
+    uint64_t perf_totals[PHASES][COUNTERS];
+    long perf_scopes[PHASES];
+} Profiler;
+
+typedef struct {
+    uint64_t min;
+    uint64_t avg;
+    uint64_t max;
+    uint64_t p99;
+} PhaseStats;
+
+void init_profiler(Profiler *p);
+
+const char *phase_name(Phase phase);
+
+// Scoped timer: keep the value of begin_phase and pass it to end_phase.
+// The phase also goes to the trace when tracing is on. Both do nothing when
+// p is NULL and tracing is off.
+uint64_t begin_phase(Profiler *p);
+
+void end_phase(Profiler *p, Phase phase, uint64_t start);
+
+// Moves the phases timed since the previous call into the window.
+void end_profiler_frame(Profiler *p);
+
+PhaseStats phase_stats(Profiler *p, Phase phase);
+
+// Phase times of the last finished frame.
+void last_frame_phases(Profiler *p, uint64_t phases[PHASES]);
+
+// Counter totals of every phase, per scope and as IPC.
+void write_perf_report(Profiler *p, FILE *f);
+
+// Frame time graph, one bar per frame with the phases stacked, and the
+// statistics of every phase next to it.
+void draw_profiler(Profiler *p, int x, int y);
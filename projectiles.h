@@ -1,4 +1,7 @@
+#pragma once
+
 #include "include/raylib.h"
+#include "vector.h"
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
@@ -9,20 +12,6 @@ typedef struct {
     float radius;
 } Projectile;
 
-typedef Projectile **ProjectilesVector;
-
-Projectile *make_projectile(Vector2 center, float direction);
-
-ProjectilesVector make_projectiles_vector(int size);
-
-int projectiles_vector_len(ProjectilesVector v);
-
-int projectiles_vector_cap(ProjectilesVector v);
-
-void free_projectile(Projectile *p);
-
-void expand_projectiles_vector(ProjectilesVector* old_v, int size);
-
-void append_to_projectiles_vector(ProjectilesVector *v, Projectile *p);
+DEFINE_VECTOR(ProjectilesVector, Projectile, projectiles_vector)
 
-void delete_from_projectiles_vector(ProjectilesVector v, int idx);
+Projectile make_projectile(Vector2 center, float direction);
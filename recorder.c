@@ -0,0 +1,152 @@
+#include "recorder.h"
+#include "alloc.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLIGHT_MAGIC "ASTFLT2"
+
+void init_flight_recorder(FlightRecorder *r, WorldConfig config, const char *dir, uint64_t budget_ns,
+			  int interval) {
+    assert(interval > 0 && "Keyframe interval must be positive");
+
+    r->dir = dir;
+    r->budget_ns = budget_ns;
+    r->interval = interval;
+    r->after = interval / 2;
+    r->capacity = 2 * interval + r->after;
+    r->frames = tracked_malloc(sizeof(FrameRecord) * r->capacity);
+    assert(r->frames != NULL && "Can't allocate flight recorder");
+
+    r->frames_count = 0;
+    for (int i = 0; i < 2; i++) {
+	init_world_snapshot(&r->keyframes[i], config);
+	r->keyframe_frames[i] = -1;
+    }
+    r->newest = 0;
+    r->dump_at = -1;
+    r->dumps = 0;
+}
+
+void free_flight_recorder(FlightRecorder *r) {
+    tracked_free(r->frames);
+    free_world_snapshot(&r->keyframes[0]);
+    free_world_snapshot(&r->keyframes[1]);
+}
+
+void flight_recorder_before_tick(FlightRecorder *r, World *w) {
+    long last = r->keyframe_frames[r->newest];
+    if (last >= 0 && r->frames_count - last < r->interval) {
+	return;
+    }
+
+    // A pending dump needs the older keyframe, keep it until it's written.
+    if (r->dump_at >= 0 && r->keyframe_frames[r->newest] >= 0) {
+	return;
+    }
+
+    r->newest = 1 - r->newest;
+    take_world_snapshot(&r->keyframes[r->newest], w);
+    r->keyframe_frames[r->newest] = r->frames_count;
+}
+
+// Frames since the older keyframe when they are still in the ring, else
+// since the newer one. Keyframes are only taken while the world ticks, so
+// after a while on the game over screens both are older than the ring; the
+// ring is then written without a keyframe, timings only.
+static int dump_keyframe(FlightRecorder *r) {
+    int candidates[] = {1 - r->newest, r->newest};
+    for (int i = 0; i < 2; i++) {
+	long from = r->keyframe_frames[candidates[i]];
+	if (from >= 0 && r->frames_count - from <= r->capacity) {
+	    return candidates[i];
+	}
+    }
+    return -1;
+}
+
+static void dump_flight(FlightRecorder *r) {
+    int keyframe = dump_keyframe(r);
+    bool has_keyframe = keyframe >= 0;
+    long from = has_keyframe ? r->keyframe_frames[keyframe] :
+	(r->frames_count > r->capacity ? r->frames_count - r->capacity : 0);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/flight-%ld.bin", r->dir, r->frames_count);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+	fprintf(stderr, "flight recorder: can't write %s\n", path);
+	return;
+    }
+
+    long count = r->frames_count - from;
+    bool ok = fwrite(FLIGHT_MAGIC, sizeof(FLIGHT_MAGIC), 1, f) == 1 &&
+	fwrite(&has_keyframe, sizeof(has_keyframe), 1, f) == 1 &&
+	(!has_keyframe || write_world_snapshot(f, &r->keyframes[keyframe])) &&
+	fwrite(&count, sizeof(count), 1, f) == 1;
+    for (long i = from; i < r->frames_count && ok; i++) {
+	ok = fwrite(&r->frames[i % r->capacity], sizeof(FrameRecord), 1, f) == 1;
+    }
+
+    if (fclose(f) != 0 || !ok) {
+	fprintf(stderr, "flight recorder: can't write %s\n", path);
+	return;
+    }
+
+    r->dumps++;
+    fprintf(stderr, "flight recorder: %ld frames written to %s%s\n", count, path,
+	    has_keyframe ? "" : ", without a keyframe: the world didn't tick for the whole ring");
+}
+
+void record_flight_frame(FlightRecorder *r, FrameRecord *frame) {
+    frame->frame = r->frames_count;
+    r->frames[r->frames_count % r->capacity] = *frame;
+    r->frames_count++;
+
+    if (frame->frame_ns > r->budget_ns && r->dump_at < 0 && r->dumps < MAX_FLIGHT_DUMPS) {
+	r->dump_at = r->frames_count + r->after;
+    }
+
+    if (r->dump_at >= 0 && r->frames_count >= r->dump_at) {
+	dump_flight(r);
+	r->dump_at = -1;
+    }
+}
+
+bool read_flight_dump(const char *path, FlightDump *d) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+	return false;
+    }
+
+    char magic[sizeof(FLIGHT_MAGIC)];
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, FLIGHT_MAGIC, sizeof(magic)) == 0 &&
+	fread(&d->has_keyframe, sizeof(d->has_keyframe), 1, f) == 1 &&
+	(!d->has_keyframe || read_world_snapshot(f, &d->keyframe));
+    if (!ok) {
+	fclose(f);
+	return false;
+    }
+
+    d->frames = NULL;
+    ok = fread(&d->count, sizeof(d->count), 1, f) == 1 && d->count >= 0;
+    if (ok) {
+	d->frames = tracked_malloc(sizeof(FrameRecord) * (d->count > 0 ? d->count : 1));
+	assert(d->frames != NULL && "Can't allocate flight dump");
+	ok = fread(d->frames, sizeof(FrameRecord), d->count, f) == (size_t)d->count;
+    }
+    fclose(f);
+
+    if (!ok) {
+	free_flight_dump(d);
+    }
+    return ok;
+}
+
+void free_flight_dump(FlightDump *d) {
+    if (d->has_keyframe) {
+	free_world_snapshot(&d->keyframe);
+    }
+    tracked_free(d->frames);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "profiler.h"
+#include "world.h"
+
+// Always-on flight recorder. It keeps the last frames of the game and a
+// world keyframe every interval frames. When a frame takes longer than the
+// budget, it waits a few frames and then dumps the frames since the oldest
+// keyframe still covered by the ring, together with that keyframe. Replaying
+// the recorded inputs on the keyframe reproduces the ticks around the spike.
+// When the world hasn't ticked for the whole ring, the frames are dumped
+// without a keyframe.
+
+#define MAX_FLIGHT_DUMPS 32
+
+typedef struct {
+    long frame;
+    long tick;           // tick of the world before this frame
+    bool ticked;         // the world was stepped with input
+    WorldInput input;
+    uint64_t frame_ns;   // from the start of this frame until it is recorded
+    uint64_t phases[PHASES];
+    int asteroids;
+    int projectiles;
+} FrameRecord;
+
+typedef struct {
+    const char *dir;
+    uint64_t budget_ns;
+    int interval;        // frames between keyframes
+    int after;           // frames recorded after a spike before dumping
+    FrameRecord *frames; // ring of 2 * interval + after frames
+    int capacity;
+    long frames_count;
+    WorldSnapshot keyframes[2];
+    long keyframe_frames[2]; // frame each keyframe was taken at, -1 if none
+    int newest;              // index of the newest keyframe
+    long dump_at;            // frame to dump at, -1 if no spike is pending
+    int dumps;
+} FlightRecorder;
+
+typedef struct {
+    bool has_keyframe;
+    WorldSnapshot keyframe; // only with has_keyframe
+    long count;
+    FrameRecord *frames;
+} FlightDump;
+
+// Files go to dir, named flight-<frame>.bin.
+void init_flight_recorder(FlightRecorder *r, WorldConfig config, const char *dir, uint64_t budget_ns,
+			  int interval);
+
+void free_flight_recorder(FlightRecorder *r);
+
+// Call right before the world is stepped, keyframes are taken here.
+void flight_recorder_before_tick(FlightRecorder *r, World *w);
+
+// Call once per frame, after it ended.
+void record_flight_frame(FlightRecorder *r, FrameRecord *frame);
+
+bool read_flight_dump(const char *path, FlightDump *d);
+
+void free_flight_dump(FlightDump *d);
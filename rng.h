@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// splitmix64, small and good enough for gameplay. Each world owns one so
+// worlds never share random state.
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static inline uint64_t next_random(Rng *rng) {
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// Random integer in [min, max], both included, like raylib's GetRandomValue.
+static inline int random_value(Rng *rng, int min, int max) {
+    return min + (int)(next_random(rng) % (uint64_t)(max - min + 1));
+}
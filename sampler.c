@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+
+#include "sampler.h"
+#include "alloc.h"
+#include <dlfcn.h>
+#include <link.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+// Frames are only followed within this distance above the handler's own
+// stack frame, which keeps a stray frame pointer from being dereferenced.
+#define STACK_SPAN (8 << 20)
+
+typedef struct {
+    atomic_int depth; // stored last, a slot still being written reads as empty
+    void *pcs[SAMPLER_MAX_DEPTH]; // innermost first
+} Sample;
+
+static Sample *samples;
+static int max_samples;
+static atomic_int taken;
+static atomic_long dropped;
+
+// SIGPROF goes to any thread of the process, so a handler can still be
+// running on another thread after the timer is stopped. stop_sampler clears
+// sampling and waits for the handlers inside before it reads the samples.
+static atomic_bool sampling;
+static atomic_int handlers;
+
+static void interrupted_frame(void *context, uintptr_t *pc, uintptr_t *fp) {
+    ucontext_t *uc = context;
+#if defined(__x86_64__)
+    *pc = uc->uc_mcontext.gregs[REG_RIP];
+    *fp = uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    *pc = uc->uc_mcontext.pc;
+    *fp = uc->uc_mcontext.regs[29];
+#else
+    (void)uc;
+    *pc = 0;
+    *fp = (uintptr_t)__builtin_frame_address(0);
+#endif
+}
+
+static void take_sample(void *context) {
+    // Checked first so the index doesn't keep growing on long runs.
+    int slot = atomic_load_explicit(&taken, memory_order_relaxed);
+    if (slot < max_samples) {
+	slot = atomic_fetch_add_explicit(&taken, 1, memory_order_relaxed);
+    }
+    if (slot >= max_samples) {
+	atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+	return;
+    }
+
+    Sample *s = &samples[slot];
+    uintptr_t pc, fp;
+    interrupted_frame(context, &pc, &fp);
+
+    uintptr_t low = (uintptr_t)__builtin_frame_address(0);
+    uintptr_t high = low + STACK_SPAN;
+
+    int depth = 0;
+    if (pc != 0) {
+	s->pcs[depth++] = (void *)pc;
+    }
+
+    // Each frame starts with the caller's frame pointer, then the return address.
+    while (depth < SAMPLER_MAX_DEPTH && fp >= low && fp < high && fp % sizeof(void *) == 0) {
+	uintptr_t *frame = (uintptr_t *)fp;
+	if (frame[1] == 0) {
+	    break;
+	}
+	s->pcs[depth++] = (void *)frame[1];
+
+	if (frame[0] <= fp) {
+	    break;
+	}
+	fp = frame[0];
+    }
+
+    atomic_store_explicit(&s->depth, depth, memory_order_release);
+}
+
+static void on_sigprof(int sig, siginfo_t *info, void *context) {
+    atomic_fetch_add(&handlers, 1);
+    if (atomic_load(&sampling)) {
+	take_sample(context);
+    }
+    atomic_fetch_sub(&handlers, 1);
+}
+
+bool start_sampler(int hz, int samples_count) {
+    samples = tracked_malloc(sizeof(Sample) * samples_count);
+    if (samples == NULL) {
+	return false;
+    }
+    memset(samples, 0, sizeof(Sample) * samples_count);
+    max_samples = samples_count;
+    atomic_store(&taken, 0);
+    atomic_store(&dropped, 0);
+    atomic_store(&sampling, true);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_sigprof;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, NULL) != 0) {
+	atomic_store(&sampling, false);
+	tracked_free(samples);
+	return false;
+    }
+
+    long usec = 1000000 / (hz > 0 ? hz : DEFAULT_SAMPLER_HZ);
+    struct itimerval timer = {
+	.it_interval = {.tv_sec = usec / 1000000, .tv_usec = usec % 1000000},
+	.it_value = {.tv_sec = usec / 1000000, .tv_usec = usec % 1000000},
+    };
+    return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+// Functions of the executable from its .symtab, which unlike the dynamic
+// symbols dladdr sees also has the static ones.
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    const char *name;
+} Symbol;
+
+typedef struct {
+    Symbol *symbols; // sorted by start
+    int count;
+    char *names;     // string table the names point into
+} SymbolTable;
+
+static int executable_bias(struct dl_phdr_info *info, size_t size, void *data) {
+    (void)size;
+    *(uintptr_t *)data = info->dlpi_addr;
+    return 1; // the executable is listed first
+}
+
+static void *read_at(FILE *f, long offset, size_t size) {
+    void *data = size > 0 ? tracked_malloc(size) : NULL;
+    if (data != NULL && (fseek(f, offset, SEEK_SET) != 0 || fread(data, size, 1, f) != 1)) {
+	tracked_free(data);
+	return NULL;
+    }
+    return data;
+}
+
+static int compare_symbols(const void *a, const void *b) {
+    const Symbol *x = a;
+    const Symbol *y = b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+// Leaves the table empty when the executable is stripped or unreadable.
+static void load_executable_symbols(SymbolTable *t) {
+    t->symbols = NULL;
+    t->count = 0;
+    t->names = NULL;
+
+    FILE *f = fopen("/proc/self/exe", "rb");
+    if (f == NULL) {
+	return;
+    }
+
+    ElfW(Ehdr) header;
+    ElfW(Shdr) *sections = NULL;
+    ElfW(Sym) *symbols = NULL;
+    if (fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.e_ident, ELFMAG, SELFMAG) == 0 &&
+	header.e_shentsize == sizeof(ElfW(Shdr))) {
+	sections = read_at(f, header.e_shoff, sizeof(ElfW(Shdr)) * header.e_shnum);
+    }
+
+    ElfW(Shdr) *symtab = NULL;
+    for (int i = 0; sections != NULL && i < header.e_shnum && symtab == NULL; i++) {
+	if (sections[i].sh_type == SHT_SYMTAB && sections[i].sh_link < header.e_shnum) {
+	    symtab = &sections[i];
+	}
+    }
+
+    size_t names_size = 0;
+    if (symtab != NULL) {
+	ElfW(Shdr) *strtab = &sections[symtab->sh_link];
+	names_size = strtab->sh_size;
+	t->names = read_at(f, strtab->sh_offset, names_size);
+	symbols = read_at(f, symtab->sh_offset, symtab->sh_size);
+    }
+
+    if (t->names != NULL && symbols != NULL) {
+	t->names[names_size - 1] = '\0';
+
+	uintptr_t bias = 0;
+	dl_iterate_phdr(executable_bias, &bias);
+
+	size_t n = symtab->sh_size / sizeof(ElfW(Sym));
+	t->symbols = tracked_malloc(sizeof(Symbol) * n);
+	for (size_t i = 0; i < n && t->symbols != NULL; i++) {
+	    ElfW(Sym) *sym = &symbols[i];
+	    if (ELF64_ST_TYPE(sym->st_info) == STT_FUNC && sym->st_size > 0 && sym->st_name < names_size) {
+		t->symbols[t->count++] = (Symbol){
+		    .start = bias + sym->st_value,
+		    .end = bias + sym->st_value + sym->st_size,
+		    .name = t->names + sym->st_name,
+		};
+	    }
+	}
+	if (t->symbols != NULL) {
+	    qsort(t->symbols, t->count, sizeof(Symbol), compare_symbols);
+	}
+    }
+
+    tracked_free(symbols);
+    tracked_free(sections);
+    fclose(f);
+}
+
+static void free_symbol_table(SymbolTable *t) {
+    tracked_free(t->symbols);
+    tracked_free(t->names);
+}
+
+static const char *find_symbol(SymbolTable *t, uintptr_t at) {
+    int lo = 0;
+    int hi = t->count;
+    while (lo < hi) {
+	int mid = lo + (hi - lo) / 2;
+	if (t->symbols[mid].start <= at) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return lo > 0 && at < t->symbols[lo - 1].end ? t->symbols[lo - 1].name : NULL;
+}
+
+// Function name of a code address. Addresses without a symbol, such as the
+// internal routines of libm, are folded into their module so they add up to
+// one frame. Return addresses point after the call, hence the - 1.
+static void symbolize(SymbolTable *exe, void *pc, bool leaf, char *out, size_t size) {
+    uintptr_t at = (uintptr_t)pc - (leaf ? 0 : 1);
+    const char *name = find_symbol(exe, at);
+    Dl_info info;
+    if (name == NULL && dladdr((void *)at, &info) != 0) {
+	if (info.dli_sname != NULL) {
+	    name = info.dli_sname;
+	} else if (info.dli_fname != NULL) {
+	    const char *module = strrchr(info.dli_fname, '/');
+	    name = module != NULL ? module + 1 : info.dli_fname;
+	}
+    }
+
+    if (name != NULL) {
+	snprintf(out, size, "%s", name);
+    } else {
+	snprintf(out, size, "0x%lx", (unsigned long)at);
+    }
+}
+
+static int compare_stacks(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+bool stop_sampler(const char *path) {
+    sigset_t prof;
+    sigset_t mask;
+    sigemptyset(&prof);
+    sigaddset(&prof, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &prof, &mask);
+
+    struct itimerval off = {0};
+    setitimer(ITIMER_PROF, &off, NULL);
+    atomic_store(&sampling, false);
+    while (atomic_load(&handlers) > 0) {
+	sched_yield();
+    }
+    signal(SIGPROF, SIG_IGN);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+    int count = atomic_load(&taken);
+    if (count > max_samples) {
+	count = max_samples;
+    }
+
+    SymbolTable exe;
+    load_executable_symbols(&exe);
+
+    // One folded line per sample, outermost frame first, then count runs.
+    char **stacks = tracked_malloc(sizeof(char *) * (count > 0 ? count : 1));
+    char name[256];
+    for (int i = 0; i < count; i++) {
+	Sample *s = &samples[i];
+	size_t cap = 64;
+	size_t len = 0;
+	char *line = tracked_malloc(cap);
+	line[0] = '\0';
+
+	for (int d = atomic_load_explicit(&s->depth, memory_order_acquire) - 1; d >= 0; d--) {
+	    symbolize(&exe, s->pcs[d], d == 0, name, sizeof(name));
+	    size_t add = strlen(name) + 1;
+	    if (len + add + 1 > cap) {
+		while (len + add + 1 > cap) {
+		    cap *= 2;
+		}
+		line = tracked_realloc(line, cap);
+	    }
+	    len += sprintf(line + len, "%s%s", len > 0 ? ";" : "", name);
+	}
+	stacks[i] = line;
+    }
+    qsort(stacks, count, sizeof(char *), compare_stacks);
+    free_symbol_table(&exe);
+
+    FILE *f = fopen(path, "w");
+    bool ok = f != NULL;
+    for (int i = 0; i < count && ok; ) {
+	int j = i;
+	while (j < count && strcmp(stacks[j], stacks[i]) == 0) {
+	    j++;
+	}
+	if (stacks[i][0] != '\0') {
+	    fprintf(f, "%s %d\n", stacks[i], j - i);
+	}
+	i = j;
+    }
+    if (f != NULL && fclose(f) != 0) {
+	ok = false;
+    }
+
+    long lost = atomic_load(&dropped);
+    fprintf(stderr, "sampler: %d samples written to %s, %ld dropped\n", count, path, lost);
+
+    for (int i = 0; i < count; i++) {
+	tracked_free(stacks[i]);
+    }
+    tracked_free(stacks);
+    tracked_free(samples);
+    samples = NULL;
+
+    return ok;
+}
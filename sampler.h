@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Opt-in sampling profiler. SIGPROF fires hz times per second of CPU time
+// and the handler walks the frame pointers of whichever thread was running
+// into a buffer allocated up front; samples past its end are dropped. The
+// build keeps frame pointers and exports symbols (see the Makefile) so
+// stacks resolve to function names.
+
+#define SAMPLER_MAX_DEPTH 32
+#define DEFAULT_SAMPLER_HZ 997 // not a divisor of the frame rate
+#define DEFAULT_SAMPLER_SAMPLES (1 << 15)
+
+bool start_sampler(int hz, int max_samples);
+
+// Stops sampling and writes the stacks in the folded format of
+// flamegraph.pl and speedscope: "outer;...;inner count" per line.
+bool stop_sampler(const char *path);
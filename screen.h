@@ -0,0 +1,6 @@
+#pragma once
+
+typedef struct {
+    const int width;
+    const int height;
+} Screen;
@@ -0,0 +1,87 @@
+#include "session.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SESSION_MAGIC "ASTSES1"
+
+// About a minute of play at 60 ticks per second, the inputs grow past it.
+#define SESSION_INITIAL_TICKS 4096
+
+void init_session(Session *s, WorldConfig config, uint64_t seed) {
+    s->config = config;
+    s->seed = seed;
+    s->inputs = make_world_input_vector(SESSION_INITIAL_TICKS);
+    s->end = (SessionEnd){0};
+}
+
+void free_session(Session *s) {
+    free_world_input_vector(&s->inputs);
+}
+
+void record_session_tick(Session *s, WorldInput input) {
+    append_to_world_input_vector(&s->inputs, input);
+}
+
+SessionEnd session_end(World *w) {
+    return (SessionEnd){
+	.tick = w->tick,
+	.score = w->score,
+	.game_over = w->game_over,
+	.digest = world_digest(w),
+    };
+}
+
+void end_session(Session *s, World *w) {
+    s->end = session_end(w);
+}
+
+bool write_session(const char *path, Session *s) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+	return false;
+    }
+
+    int ticks = world_input_vector_len(s->inputs);
+    bool ok = fwrite(SESSION_MAGIC, sizeof(SESSION_MAGIC), 1, f) == 1 &&
+	fwrite(&s->config, sizeof(WorldConfig), 1, f) == 1 &&
+	fwrite(&s->seed, sizeof(s->seed), 1, f) == 1 &&
+	fwrite(&s->end, sizeof(SessionEnd), 1, f) == 1 &&
+	fwrite(&ticks, sizeof(ticks), 1, f) == 1 &&
+	fwrite(s->inputs.items, sizeof(WorldInput), ticks, f) == (size_t)ticks;
+
+    return fclose(f) == 0 && ok;
+}
+
+bool read_session(const char *path, Session *s) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+	return false;
+    }
+
+    char magic[sizeof(SESSION_MAGIC)];
+    WorldConfig config;
+    uint64_t seed;
+    SessionEnd end;
+    int ticks;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, SESSION_MAGIC, sizeof(magic)) == 0 &&
+	fread(&config, sizeof(WorldConfig), 1, f) == 1 &&
+	fread(&seed, sizeof(seed), 1, f) == 1 &&
+	fread(&end, sizeof(SessionEnd), 1, f) == 1 &&
+	fread(&ticks, sizeof(ticks), 1, f) == 1 && ticks >= 0;
+    if (!ok) {
+	fclose(f);
+	return false;
+    }
+
+    init_session(s, config, seed);
+    s->end = end;
+    reserve_world_input_vector(&s->inputs, ticks);
+    ok = fread(s->inputs.items, sizeof(WorldInput), ticks, f) == (size_t)ticks;
+    s->inputs.len = ticks;
+    fclose(f);
+
+    if (!ok) {
+	free_session(s);
+    }
+    return ok;
+}
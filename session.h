@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "world.h"
+
+// Recording of one game: the world config, its seed and the input of every
+// tick. Since step_world is deterministic, replaying the inputs on a world
+// made from the same config and seed plays the same game, which the state
+// kept at the end of the recording verifies. Files are only meant to be read
+// by the same build.
+
+DEFINE_VECTOR(WorldInputVector, WorldInput, world_input_vector)
+
+// Where the recorded game stopped.
+typedef struct {
+    long tick;
+    int score;
+    bool game_over;
+    uint64_t digest; // world_digest of the final world
+} SessionEnd;
+
+typedef struct {
+    WorldConfig config;
+    uint64_t seed;
+    WorldInputVector inputs;
+    SessionEnd end;
+} Session;
+
+void init_session(Session *s, WorldConfig config, uint64_t seed);
+
+void free_session(Session *s);
+
+// Call with the input of every tick, right before the world is stepped.
+void record_session_tick(Session *s, WorldInput input);
+
+void end_session(Session *s, World *w);
+
+SessionEnd session_end(World *w);
+
+bool write_session(const char *path, Session *s);
+
+// Initializes s from the file, free it with free_session.
+bool read_session(const char *path, Session *s);
@@ -0,0 +1,68 @@
+#include "ship.h"
+#include <math.h>
+
+void update_ship_vertices(Ship *ship) {
+    float l = (3 * PI) / 4;
+    float m = (5 * PI) / 4;
+
+    ship->vertices[0].x = ship->center.x + cos(ship->direction) * ship->max_radius;
+    ship->vertices[0].y = ship->center.y - sin(ship->direction) * ship->max_radius;
+
+    ship->vertices[1].x = ship->center.x + cos(ship->direction + l) * ship->max_radius;
+    ship->vertices[1].y = ship->center.y - sin(ship->direction + l) * ship->max_radius;
+
+    ship->vertices[2].x = ship->center.x + cos(ship->direction + m) * ship->max_radius;
+    ship->vertices[2].y = ship->center.y - sin(ship->direction + m) * ship->max_radius;
+}
+
+Ship init_ship(Vector2 center) {
+    Ship ship = {
+	.center = center,
+	.direction = 0.0,
+	.max_radius = 30,
+    };
+    update_ship_vertices(&ship);
+
+    return ship;
+}
+
+void move_ship(Ship *ship, float speed, Direction dir, Screen screen) {
+    switch (dir) {
+    case MOVE_LEFT:
+	ship->direction = fmod(ship->direction + speed, (2 * PI));
+	break;
+    case MOVE_RIGHT:
+	ship->direction = fmod(ship->direction - speed, (2 * PI));
+	break;
+    case MOVE_UP:
+	ship->center.x = ship->center.x + cos(ship->direction) * speed;
+	ship->center.y = ship->center.y - sin(ship->direction) * speed;
+	break;
+    case MOVE_DOWN:
+	ship->center.x = ship->center.x - cos(ship->direction) * speed;
+	ship->center.y = ship->center.y + sin(ship->direction) * speed;
+	break;
+    }
+
+    if (ship->center.x + ship->max_radius < 0) {
+	ship->center.x = screen.width + ship->max_radius - 1;
+    }
+
+    if (ship->center.x - ship->max_radius > screen.width) {
+	ship->center.x = 0 - ship->max_radius + 1;
+    }
+
+    if (ship->center.y + ship->max_radius < 0) {
+	ship->center.y = screen.height + ship->max_radius - 1;
+    }
+
+    if (ship->center.y - ship->max_radius > screen.height) {
+	ship->center.y = 0 - ship->max_radius;
+    }
+
+    update_ship_vertices(ship);
+}
+
+void draw_ship(Ship ship) {
+    DrawTriangleLines(ship.vertices[0], ship.vertices[1], ship.vertices[2], WHITE);
+}
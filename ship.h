@@ -0,0 +1,21 @@
+#pragma once
+
+#include "include/raylib.h"
+#include "screen.h"
+
+typedef enum { MOVE_RIGHT, MOVE_UP, MOVE_LEFT, MOVE_DOWN } Direction;
+
+typedef struct {
+    Vector2 center;
+    Vector2 vertices[3];
+    float direction;
+    float max_radius;
+} Ship;
+
+Ship init_ship(Vector2 center);
+
+void update_ship_vertices(Ship *ship);
+
+void move_ship(Ship *ship, float speed, Direction dir, Screen screen);
+
+void draw_ship(Ship ship);
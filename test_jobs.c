@@ -0,0 +1,67 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "jobs.h"
+#include "timing.h"
+
+// Checks of the job system. Every check runs under an alarm, so a hang
+// fails the test instead of blocking the build.
+
+#define TEST_TIMEOUT_S 20
+#define CHAIN_LENGTH 4
+
+typedef struct {
+    atomic_int order[CHAIN_LENGTH];
+    atomic_int next;
+} Chain;
+
+static void slow_link(void *ctx, int begin, int end) {
+    Chain *c = ctx;
+    sleep_ns(50000000);
+    atomic_store(&c->order[begin], atomic_fetch_add(&c->next, 1));
+}
+
+// A chain of jobs, each submitted after the previous one. The submitting
+// thread sleeps before it waits, so the other workers steal the links,
+// park the ones whose dependency is pending and go idle. Finishing a link
+// must get its dependent running on whichever worker parked it.
+static void test_dependency_chain(int workers) {
+    JobSystem *js = init_job_system(workers);
+
+    Chain chain = {0};
+    JobCounter counters[CHAIN_LENGTH];
+    for (int i = 0; i < CHAIN_LENGTH; i++) {
+	atomic_init(&counters[i].pending, 0);
+	submit_job_after(js, i > 0 ? &counters[i - 1] : NULL, slow_link, &chain, i, i + 1, &counters[i]);
+    }
+
+    sleep_ns(20000000);
+    wait_for_jobs(js, &counters[CHAIN_LENGTH - 1]);
+
+    for (int i = 0; i < CHAIN_LENGTH; i++) {
+	assert(atomic_load(&chain.order[i]) == i && "Dependent job ran before its dependency");
+    }
+    free_job_system(js);
+}
+
+static void timeout(int sig) {
+    static const char message[] = "test_jobs: timed out\n";
+    write(STDERR_FILENO, message, sizeof(message) - 1);
+    _exit(1);
+}
+
+int main(void) {
+    signal(SIGALRM, timeout);
+    alarm(TEST_TIMEOUT_S);
+
+    for (int workers = 2; workers <= 4; workers++) {
+	test_dependency_chain(workers);
+    }
+
+    printf("test_jobs: ok\n");
+    return 0;
+}
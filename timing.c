@@ -0,0 +1,18 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "timing.h"
+#include <time.h>
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void sleep_ns(uint64_t ns) {
+    struct timespec ts = {
+	.tv_sec = ns / 1000000000,
+	.tv_nsec = ns % 1000000000,
+    };
+    nanosleep(&ts, NULL);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+// Monotonic clock in nanoseconds.
+uint64_t now_ns(void);
+
+void sleep_ns(uint64_t ns);
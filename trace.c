@@ -0,0 +1,176 @@
+#include "trace.h"
+#include "alloc.h"
+#include "timing.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Scopes are timed with the cycle counter, a clock_gettime call costs more
+// than the rest of a scope. Its ticks are converted to nanoseconds when the
+// trace is written, with the rate measured since start_tracing.
+#if defined(__x86_64__)
+#include <x86intrin.h>
+
+static inline uint64_t trace_clock(void) {
+    return __rdtsc();
+}
+#elif defined(__aarch64__)
+static inline uint64_t trace_clock(void) {
+    uint64_t t;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+}
+#else
+#define TRACE_CLOCK_IS_NS
+static inline uint64_t trace_clock(void) {
+    return now_ns();
+}
+#endif
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+    bool ticks; // timed with trace_clock, otherwise in nanoseconds
+} TraceEvent;
+
+typedef struct TraceRing {
+    struct TraceRing *next;
+    int thread;
+    atomic_ulong written; // total events, the ring holds the last mask + 1
+    unsigned long mask;
+    TraceEvent events[];
+} TraceRing;
+
+static atomic_bool enabled;
+static int ring_size;
+static _Atomic(TraceRing *) rings;
+static atomic_int threads;
+static uint64_t trace_start;
+static uint64_t trace_start_ticks;
+
+// Rings of an earlier start_tracing are freed, a thread that still points
+// to one sees it by its generation without touching it.
+static atomic_int generation;
+static _Thread_local TraceRing *ring;
+static _Thread_local int ring_generation;
+
+void start_tracing(int events_per_thread) {
+    // Round up to a power of two so the ring index is a mask.
+    int size = 1;
+    while (size < events_per_thread) {
+	size <<= 1;
+    }
+
+    ring_size = size;
+    atomic_fetch_add(&generation, 1);
+    trace_start = now_ns();
+    trace_start_ticks = trace_clock();
+    atomic_store(&enabled, true);
+}
+
+void stop_tracing(void) {
+    atomic_store(&enabled, false);
+
+    TraceRing *r = atomic_exchange(&rings, NULL);
+    while (r != NULL) {
+	TraceRing *next = r->next;
+	tracked_free(r);
+	r = next;
+    }
+    atomic_store(&threads, 0);
+}
+
+bool tracing_enabled(void) {
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+// The first event of a thread allocates its ring and links it in front of
+// the list, the only shared write.
+static TraceRing *thread_ring(void) {
+    int current = atomic_load_explicit(&generation, memory_order_relaxed);
+    if (ring != NULL && ring_generation == current) {
+	return ring;
+    }
+
+    TraceRing *r = tracked_malloc(sizeof(TraceRing) + sizeof(TraceEvent) * ring_size);
+    assert(r != NULL && "Can't allocate trace ring");
+
+    r->thread = atomic_fetch_add(&threads, 1);
+    atomic_init(&r->written, 0);
+    r->mask = ring_size - 1;
+
+    r->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &r->next, r)) {
+    }
+
+    ring = r;
+    ring_generation = current;
+    return r;
+}
+
+static void record_event(const char *name, uint64_t start, uint64_t end, bool ticks) {
+    TraceRing *r = thread_ring();
+    unsigned long n = atomic_load_explicit(&r->written, memory_order_relaxed);
+    r->events[n & r->mask] = (TraceEvent){name, start, end, ticks};
+    atomic_store_explicit(&r->written, n + 1, memory_order_release);
+}
+
+uint64_t trace_begin(void) {
+    return tracing_enabled() ? trace_clock() : 0;
+}
+
+void trace_end(const char *name, uint64_t start) {
+    // Scopes opened before tracing started have no start time.
+    if (tracing_enabled() && start >= trace_start_ticks) {
+	record_event(name, start, trace_clock(), true);
+    }
+}
+
+void trace_event(const char *name, uint64_t start, uint64_t end) {
+    if (tracing_enabled() && start >= trace_start) {
+	record_event(name, start, end, false);
+    }
+}
+
+bool write_trace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+	return false;
+    }
+
+    // The longer the trace, the more precise the rate of the cycle counter.
+    double ns_per_tick = 1;
+#ifndef TRACE_CLOCK_IS_NS
+    uint64_t ticks = trace_clock() - trace_start_ticks;
+    uint64_t ns = now_ns() - trace_start;
+    if (ticks > 0) {
+	ns_per_tick = (double)ns / ticks;
+    }
+#endif
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (TraceRing *r = atomic_load(&rings); r != NULL; r = r->next) {
+	fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+		first ? "" : ",\n", r->thread, r->thread);
+	first = false;
+
+	unsigned long written = atomic_load_explicit(&r->written, memory_order_acquire);
+	unsigned long begin = written > r->mask + 1 ? written - r->mask - 1 : 0;
+
+	for (unsigned long i = begin; i < written; i++) {
+	    TraceEvent e = r->events[i & r->mask];
+	    // Timestamps are microseconds since start_tracing.
+	    double start = e.ticks ? (e.start - trace_start_ticks) * ns_per_tick : e.start - trace_start;
+	    double duration = e.ticks ? (e.end - e.start) * ns_per_tick : e.end - e.start;
+	    fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+		    e.name, r->thread, start / 1e3, duration / 1e3);
+	}
+    }
+
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Timeline of named scopes for chrome://tracing and ui.perfetto.dev. Every
+// thread records into its own ring, so recording takes no locks; when a ring
+// is full the oldest events are overwritten. Tracing is off until
+// start_tracing and scopes cost a branch while it is off.
+
+#define DEFAULT_TRACE_EVENTS (1 << 16)
+
+void start_tracing(int events_per_thread);
+
+// Frees the rings. Call while no other thread records, for example after
+// free_job_system or between frames. Tracing can be started again later.
+void stop_tracing(void);
+
+bool tracing_enabled(void);
+
+// Scope timer: keep the value of trace_begin and pass it to trace_end. The
+// value is a cycle count, not a time. name must outlive the trace, string
+// literals are fine.
+uint64_t trace_begin(void);
+
+void trace_end(const char *name, uint64_t start);
+
+// Records a scope that was timed by the caller with now_ns.
+void trace_event(const char *name, uint64_t start, uint64_t end);
+
+// Writes every recorded event as Chrome trace-event JSON. Threads may keep
+// recording meanwhile, events they overwrite during the write can be lost.
+bool write_trace(const char *path);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "alloc.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// DEFINE_VECTOR(Name, T, name) declares a growable array of T called Name
+// and its functions, all prefixed or suffixed with name:
+//
+//   make_name(cap), free_name(&v), name_len(v), name_cap(v)
+//   reserve_name(&v, cap)           grow to at least cap
+//   append_to_name(&v, item)        amortized O(1), capacity doubles
+//   try_append_to_name(&v, item)    false instead of growing when full
+//   delete_from_name(&v, idx)       O(n), keeps the order
+//   swap_delete_from_name(&v, idx)  O(1), moves the last item into idx
+//   compact_name(&v, to_delete)     drops every item flagged in to_delete, keeps the order
+//   shrink_name(&v)                 releases unused capacity
+#define DEFINE_VECTOR(Name, T, name)                                            \
+    typedef struct {                                                            \
+	T *items;                                                               \
+	int len;                                                                \
+	int cap;                                                                \
+    } Name;                                                                     \
+                                                                                \
+    static inline Name make_##name(int cap) {                                   \
+	Name v = {.items = NULL, .len = 0, .cap = cap};                         \
+	if (cap > 0) {                                                          \
+	    v.items = tracked_malloc(sizeof(T) * cap);                          \
+	    assert(v.items != NULL && "Can't allocate " #name);                 \
+	}                                                                       \
+	return v;                                                               \
+    }                                                                           \
+                                                                                \
+    static inline void free_##name(Name *v) {                                   \
+	tracked_free(v->items);                                                 \
+	*v = (Name){0};                                                         \
+    }                                                                           \
+                                                                                \
+    static inline int name##_len(Name v) {                                      \
+	return v.len;                                                           \
+    }                                                                           \
+                                                                                \
+    static inline int name##_cap(Name v) {                                      \
+	return v.cap;                                                           \
+    }                                                                           \
+                                                                                \
+    static inline void reserve_##name(Name *v, int cap) {                       \
+	if (cap <= v->cap) {                                                    \
+	    return;                                                             \
+	}                                                                       \
+	T *items = tracked_realloc(v->items, sizeof(T) * cap);                  \
+	assert(items != NULL && "Can't grow " #name);                           \
+	v->items = items;                                                       \
+	v->cap = cap;                                                           \
+    }                                                                           \
+                                                                                \
+    static inline void append_to_##name(Name *v, T item) {                      \
+	if (v->len == v->cap) {                                                 \
+	    reserve_##name(v, v->cap < 4 ? 4 : v->cap * 2);                     \
+	}                                                                       \
+	v->items[v->len++] = item;                                              \
+    }                                                                           \
+                                                                                \
+    static inline bool try_append_to_##name(Name *v, T item) {                  \
+	if (v->len == v->cap) {                                                 \
+	    return false;                                                       \
+	}                                                                       \
+	v->items[v->len++] = item;                                              \
+	return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline void delete_from_##name(Name *v, int idx) {                   \
+	assert(idx >= 0 && idx < v->len && "Index out of " #name);              \
+	memmove(v->items + idx, v->items + idx + 1,                             \
+		sizeof(T) * (v->len - idx - 1));                                \
+	v->len--;                                                               \
+    }                                                                           \
+                                                                                \
+    static inline void swap_delete_from_##name(Name *v, int idx) {              \
+	assert(idx >= 0 && idx < v->len && "Index out of " #name);              \
+	v->items[idx] = v->items[--v->len];                                     \
+    }                                                                           \
+                                                                                \
+    static inline void compact_##name(Name *v, const bool *to_delete) {         \
+	int kept = 0;                                                           \
+	for (int i = 0; i < v->len; i++) {                                      \
+	    if (!to_delete[i]) {                                                \
+		if (kept != i) {                                                \
+		    v->items[kept] = v->items[i];                               \
+		}                                                               \
+		kept++;                                                         \
+	    }                                                                   \
+	}                                                                       \
+	v->len = kept;                                                          \
+    }                                                                           \
+                                                                                \
+    static inline void shrink_##name(Name *v) {                                 \
+	if (v->len == v->cap) {                                                 \
+	    return;                                                             \
+	}                                                                       \
+	if (v->len == 0) {                                                      \
+	    tracked_free(v->items);                                             \
+	    v->items = NULL;                                                    \
+	    v->cap = 0;                                                         \
+	    return;                                                             \
+	}                                                                       \
+	T *items = tracked_realloc(v->items, sizeof(T) * v->len);               \
+	assert(items != NULL && "Can't shrink " #name);                         \
+	v->items = items;                                                       \
+	v->cap = v->len;                                                        \
+    }
@@ -0,0 +1,367 @@
+#include "world.h"
+#include "alloc.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+typedef enum { RIGHT, TOP, LEFT, BOTTOM } ScreenSide;
+
+WorldConfig default_world_config() {
+    return (WorldConfig){
+	.width = 1800,
+	.height = 1450,
+	.rotation_speed = 0.06,
+	.move_speed = 5,
+	.projectile_speed = 12,
+	.max_asteroids = 9,
+	.max_projectiles = 128,
+	.asteroid_policy = BUDGET_REFUSE,
+	.projectile_policy = BUDGET_DROP_OLDEST,
+	.spawn_chance = 31,
+	.frame_arena_size = 256 << 10,
+    };
+}
+
+Screen world_screen(World *w) {
+    return (Screen){.width = w->config.width, .height = w->config.height};
+}
+
+static bool is_on_screen(Vector2 point, float radius, Screen screen) {
+    return point.x + radius >= 0 && point.x - radius <= screen.width &&
+	point.y + radius >= 0 && point.y - radius <= screen.height;
+}
+
+static void move_projectile_forward(Projectile *p, float speed) {
+    p->center.x = p->center.x + cos(p->direction) * speed;
+    p->center.y = p->center.y - sin(p->direction) * speed;
+}
+
+static void clear_entities(World *w) {
+    w->projectiles.len = 0;
+    w->asteroids.len = 0;
+}
+
+void init_world(World *w, WorldConfig config, uint64_t seed) {
+    w->config = config;
+    w->projectiles = make_projectiles_vector(config.max_projectiles);
+    w->asteroids = make_asteroids_vector(config.max_asteroids);
+    init_arena(&w->frame_arena, config.frame_arena_size);
+    w->asteroid_budget = (BudgetStats){0};
+    w->projectile_budget = (BudgetStats){0};
+    w->profiler = NULL;
+    w->collisions = (CollisionCounters){0};
+    w->collisions_total = (CollisionCounters){0};
+    reset_world(w, seed);
+}
+
+void reset_world(World *w, uint64_t seed) {
+    clear_entities(w);
+
+    w->rng = (Rng){seed};
+    w->ship = init_ship((Vector2){500.0, 500.0});
+    w->score = 0;
+    w->game_over = false;
+    w->tick = 0;
+}
+
+void free_world(World *w) {
+    free_projectiles_vector(&w->projectiles);
+    free_asteroids_vector(&w->asteroids);
+    free_arena(&w->frame_arena);
+}
+
+static void add_projectile(World *w, Projectile p) {
+    ProjectilesVector *v = &w->projectiles;
+    if (try_append_to_projectiles_vector(v, p)) {
+	return;
+    }
+
+    switch (w->config.projectile_policy) {
+    case BUDGET_DROP_OLDEST:
+	// Projectiles are kept in firing order, so the oldest one is first.
+	delete_from_projectiles_vector(v, 0);
+	try_append_to_projectiles_vector(v, p);
+	w->projectile_budget.dropped++;
+	return;
+    case BUDGET_RECYCLE_OFFSCREEN:
+	for (int i = 0; i < projectiles_vector_len(*v); i++) {
+	    if (!is_on_screen(v->items[i].center, v->items[i].radius, world_screen(w))) {
+		v->items[i] = p;
+		w->projectile_budget.recycled++;
+		return;
+	    }
+	}
+	break;
+    case BUDGET_REFUSE:
+	break;
+    }
+
+    w->projectile_budget.refused++;
+}
+
+static void add_asteroid(World *w, Asteroid a) {
+    AsteroidsVector *v = &w->asteroids;
+    if (try_append_to_asteroids_vector(v, a)) {
+	return;
+    }
+
+    switch (w->config.asteroid_policy) {
+    case BUDGET_DROP_OLDEST:
+	delete_from_asteroids_vector(v, 0);
+	try_append_to_asteroids_vector(v, a);
+	w->asteroid_budget.dropped++;
+	return;
+    case BUDGET_RECYCLE_OFFSCREEN:
+	for (int i = 0; i < asteroids_vector_len(*v); i++) {
+	    if (!is_on_screen(v->items[i].center, v->items[i].max_radius, world_screen(w))) {
+		v->items[i] = a;
+		w->asteroid_budget.recycled++;
+		return;
+	    }
+	}
+	break;
+    case BUDGET_REFUSE:
+	break;
+    }
+
+    w->asteroid_budget.refused++;
+}
+
+static void spawn_asteroid(World *w) {
+    Screen screen = world_screen(w);
+    Asteroid a;
+    float direction;
+
+    switch (random_value(&w->rng, RIGHT, BOTTOM)) {
+    case RIGHT:
+	direction = random_value(&w->rng, 90, 270) * DEG2RAD;
+	a = init_asteroid(&w->rng, screen.width, random_value(&w->rng, 0, screen.height), direction);
+	break;
+    case TOP:
+	direction = random_value(&w->rng, 180, 360) * DEG2RAD;
+	a = init_asteroid(&w->rng, random_value(&w->rng, 180, 360), 0, direction);
+	break;
+    case LEFT:
+	direction = (random_value(&w->rng, 270, 450) % 360) * DEG2RAD;
+	a = init_asteroid(&w->rng, 0, random_value(&w->rng, 0, screen.height), direction);
+	break;
+    default:
+	direction = (random_value(&w->rng, 270, 450) % 360) * DEG2RAD;
+	a = init_asteroid(&w->rng, random_value(&w->rng, 0, 180), screen.height, direction);
+	break;
+    }
+
+    add_asteroid(w, a);
+}
+
+void step_world(World *w, JobSystem *js, WorldInput input) {
+    if (w->game_over) {
+	return;
+    }
+
+    WorldConfig *c = &w->config;
+    Screen screen = world_screen(w);
+
+    reset_arena(&w->frame_arena);
+
+    uint64_t t = begin_phase(w->profiler);
+
+    if (input.keys & WORLD_LEFT) {
+	move_ship(&w->ship, c->rotation_speed, MOVE_LEFT, screen);
+    }
+
+    if (input.keys & WORLD_RIGHT) {
+	move_ship(&w->ship, c->rotation_speed, MOVE_RIGHT, screen);
+    }
+
+    if (input.keys & WORLD_UP) {
+	move_ship(&w->ship, c->move_speed, MOVE_UP, screen);
+    }
+
+    if (input.keys & WORLD_DOWN) {
+	move_ship(&w->ship, c->move_speed, MOVE_DOWN, screen);
+    }
+
+    for (int i = 0; i < input.shots && i < MAX_SHOTS_PER_TICK; i++) {
+	Projectile p = make_projectile(w->ship.vertices[0], w->ship.direction);
+	// Catch up with the time since the key was pressed.
+	move_projectile_forward(&p, c->projectile_speed * input.shot_lead[i]);
+	add_projectile(w, p);
+    }
+
+    end_phase(w->profiler, PHASE_INPUT, t);
+    t = begin_phase(w->profiler);
+
+    bool *offscreen = arena_alloc(&w->frame_arena, sizeof(bool) * projectiles_vector_len(w->projectiles));
+    for (int i = 0; i < projectiles_vector_len(w->projectiles); i++) {
+	Projectile *p = &w->projectiles.items[i];
+	offscreen[i] = !is_on_screen(p->center, p->radius, screen);
+	if (!offscreen[i]) {
+	    move_projectile_forward(p, c->projectile_speed);
+	}
+    }
+
+    end_phase(w->profiler, PHASE_PROJECTILES, t);
+    t = begin_phase(w->profiler);
+
+    compact_projectiles_vector(&w->projectiles, offscreen);
+
+    offscreen = arena_alloc(&w->frame_arena, sizeof(bool) * asteroids_vector_len(w->asteroids));
+    for (int i = 0; i < asteroids_vector_len(w->asteroids); i++) {
+	Asteroid *a = &w->asteroids.items[i];
+	offscreen[i] = !is_on_screen(a->center, a->max_radius, screen);
+    }
+    compact_asteroids_vector(&w->asteroids, offscreen);
+
+    end_phase(w->profiler, PHASE_CULL, t);
+    t = begin_phase(w->profiler);
+
+    CollisionResult hits = detect_collisions(js, &w->frame_arena, screen, &w->ship, w->asteroids, w->projectiles);
+    if (hits.ship_hit) {
+	w->game_over = true;
+    }
+    w->score += hits.score;
+    w->collisions = hits.counters;
+    add_collision_counters(&w->collisions_total, &hits.counters);
+
+    end_phase(w->profiler, PHASE_COLLISION, t);
+    t = begin_phase(w->profiler);
+
+    compact_asteroids_vector(&w->asteroids, hits.asteroids_to_delete);
+    compact_projectiles_vector(&w->projectiles, hits.projectiles_to_delete);
+
+    end_phase(w->profiler, PHASE_DELETE, t);
+    t = begin_phase(w->profiler);
+
+    if (!w->game_over) {
+	move_asteroids(js, w->asteroids);
+    }
+
+    end_phase(w->profiler, PHASE_MOVE, t);
+    t = begin_phase(w->profiler);
+
+    // A full world with nothing to make room doesn't roll for a spawn.
+    bool room = asteroids_vector_len(w->asteroids) < asteroids_vector_cap(w->asteroids) ||
+	c->asteroid_policy != BUDGET_REFUSE;
+    if (room && random_value(&w->rng, 1, c->spawn_chance) == 1) {
+	spawn_asteroid(w);
+    }
+
+    end_phase(w->profiler, PHASE_SPAWN, t);
+
+    w->tick++;
+}
+
+// FNV-1a
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+	h = (h ^ bytes[i]) * 0x100000001b3;
+    }
+    return h;
+}
+
+uint64_t world_digest(World *w) {
+    uint64_t h = 0xcbf29ce484222325;
+    h = hash_bytes(h, &w->rng, sizeof(Rng));
+    h = hash_bytes(h, &w->ship, sizeof(Ship));
+    h = hash_bytes(h, &w->score, sizeof(w->score));
+    h = hash_bytes(h, &w->game_over, sizeof(w->game_over));
+    h = hash_bytes(h, &w->tick, sizeof(w->tick));
+
+    for (int i = 0; i < asteroids_vector_len(w->asteroids); i++) {
+	// Field by field, the shape pointer differs between runs.
+	Asteroid *a = &w->asteroids.items[i];
+	h = hash_bytes(h, &a->center, sizeof(a->center));
+	h = hash_bytes(h, &a->rotation_speed, sizeof(a->rotation_speed));
+	h = hash_bytes(h, &a->move_speed, sizeof(a->move_speed));
+	h = hash_bytes(h, &a->direction, sizeof(a->direction));
+	h = hash_bytes(h, &a->angle, sizeof(a->angle));
+	h = hash_bytes(h, &a->max_radius, sizeof(a->max_radius));
+	h = hash_bytes(h, a->vector_coords, sizeof(Vector2) * a->coords_size);
+    }
+
+    for (int i = 0; i < projectiles_vector_len(w->projectiles); i++) {
+	h = hash_bytes(h, &w->projectiles.items[i], sizeof(Projectile));
+    }
+
+    return h;
+}
+
+void init_world_snapshot(WorldSnapshot *s, WorldConfig config) {
+    s->asteroids = tracked_malloc(sizeof(Asteroid) * config.max_asteroids);
+    s->projectiles = tracked_malloc(sizeof(Projectile) * config.max_projectiles);
+    assert(s->asteroids != NULL && s->projectiles != NULL && "Can't allocate world snapshot");
+
+    memset(&s->state, 0, sizeof(World));
+    s->state.config = config;
+}
+
+void free_world_snapshot(WorldSnapshot *s) {
+    tracked_free(s->asteroids);
+    tracked_free(s->projectiles);
+}
+
+void take_world_snapshot(WorldSnapshot *s, World *w) {
+    assert(asteroids_vector_len(w->asteroids) <= s->state.config.max_asteroids &&
+	   projectiles_vector_len(w->projectiles) <= s->state.config.max_projectiles &&
+	   "Snapshot is too small for the world");
+
+    s->state = *w;
+    s->state.asteroids.items = NULL;
+    s->state.projectiles.items = NULL;
+    s->state.frame_arena = (Arena){0};
+    s->state.profiler = NULL;
+
+    memcpy(s->asteroids, w->asteroids.items, sizeof(Asteroid) * asteroids_vector_len(w->asteroids));
+    memcpy(s->projectiles, w->projectiles.items, sizeof(Projectile) * projectiles_vector_len(w->projectiles));
+}
+
+void restore_world_snapshot(World *w, WorldSnapshot *s) {
+    int asteroids = asteroids_vector_len(s->state.asteroids);
+    int projectiles = projectiles_vector_len(s->state.projectiles);
+    assert(asteroids <= asteroids_vector_cap(w->asteroids) &&
+	   projectiles <= projectiles_vector_cap(w->projectiles) &&
+	   "World is too small for the snapshot");
+
+    World keep = *w;
+    *w = s->state;
+    w->asteroids = keep.asteroids;
+    w->projectiles = keep.projectiles;
+    w->frame_arena = keep.frame_arena;
+    w->profiler = keep.profiler;
+
+    memcpy(w->asteroids.items, s->asteroids, sizeof(Asteroid) * asteroids);
+    memcpy(w->projectiles.items, s->projectiles, sizeof(Projectile) * projectiles);
+    w->asteroids.len = asteroids;
+    w->projectiles.len = projectiles;
+}
+
+bool write_world_snapshot(FILE *f, WorldSnapshot *s) {
+    return fwrite(&s->state, sizeof(World), 1, f) == 1 &&
+	fwrite(s->asteroids, sizeof(Asteroid), s->state.asteroids.len, f) == s->state.asteroids.len &&
+	fwrite(s->projectiles, sizeof(Projectile), s->state.projectiles.len, f) == s->state.projectiles.len;
+}
+
+bool read_world_snapshot(FILE *f, WorldSnapshot *s) {
+    World state;
+    if (fread(&state, sizeof(World), 1, f) != 1 ||
+	state.asteroids.len < 0 || state.asteroids.len > state.config.max_asteroids ||
+	state.projectiles.len < 0 || state.projectiles.len > state.config.max_projectiles) {
+	return false;
+    }
+
+    init_world_snapshot(s, state.config);
+    s->state = state;
+
+    if (fread(s->asteroids, sizeof(Asteroid), state.asteroids.len, f) != state.asteroids.len ||
+	fread(s->projectiles, sizeof(Projectile), state.projectiles.len, f) != state.projectiles.len) {
+	free_world_snapshot(s);
+	return false;
+    }
+
+    for (int i = 0; i < state.asteroids.len; i++) {
+	restore_asteroid_shape(&s->asteroids[i]);
+    }
+    return true;
+}
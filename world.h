@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "arena.h"
+#include "asteroids.h"
+#include "collision.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "projectiles.h"
+#include "rng.h"
+#include "ship.h"
+
+#define MAX_SHOTS_PER_TICK 8
+
+// What happens to a new entity when its class is at its budget.
+typedef enum {
+    BUDGET_REFUSE,            // the entity isn't created
+    BUDGET_DROP_OLDEST,       // the oldest entity makes room
+    BUDGET_RECYCLE_OFFSCREEN, // an off-screen entity makes room, refuse if there is none
+} BudgetPolicy;
+
+typedef struct {
+    int width;
+    int height;
+    float rotation_speed;
+    float move_speed;
+    float projectile_speed;
+    int max_asteroids;
+    int max_projectiles;
+    BudgetPolicy asteroid_policy;
+    BudgetPolicy projectile_policy;
+    int spawn_chance; // an asteroid spawns with a chance of 1 in spawn_chance per tick
+    size_t frame_arena_size;
+} WorldConfig;
+
+// How often a budget was hit, counted since init_world.
+typedef struct {
+    long refused;
+    long dropped;
+    long recycled;
+} BudgetStats;
+
+typedef enum { WORLD_LEFT = 1, WORLD_RIGHT = 2, WORLD_UP = 4, WORLD_DOWN = 8 } WorldKeys;
+
+// Everything a tick of the simulation reads from the player.
+typedef struct {
+    uint8_t keys;
+    uint8_t shots;
+    float shot_lead[MAX_SHOTS_PER_TICK];
+} WorldInput;
+
+// One independent game. Worlds share nothing, so any number of them can be
+// stepped at the same time from different threads. Entity storage is
+// reserved by init_world for the configured budgets and never grows.
+typedef struct {
+    WorldConfig config;
+    Rng rng;
+    Ship ship;
+    ProjectilesVector projectiles;
+    AsteroidsVector asteroids;
+    Arena frame_arena; // reset at the start of every tick
+    BudgetStats asteroid_budget;
+    BudgetStats projectile_budget;
+    Profiler *profiler; // optional, times the phases of step_world
+    CollisionCounters collisions; // of the last tick
+    CollisionCounters collisions_total; // since init_world
+    int score;
+    bool game_over;
+    long tick;
+} World;
+
+// Copy of everything a tick reads. The entity buffers are sized for the
+// budgets of the world, so taking a snapshot never allocates. Files written
+// by write_world_snapshot are only meant to be read by the same build.
+typedef struct {
+    World state; // its pointers are not used
+    Asteroid *asteroids;
+    Projectile *projectiles;
+} WorldSnapshot;
+
+WorldConfig default_world_config();
+
+Screen world_screen(World *w);
+
+void init_world(World *w, WorldConfig config, uint64_t seed);
+
+// Starts a new game, keeping the buffers of the previous one.
+void reset_world(World *w, uint64_t seed);
+
+void free_world(World *w);
+
+void step_world(World *w, JobSystem *js, WorldInput input);
+
+// Hash of the simulated state: rng, ship, entities, score and tick. Equal
+// digests mean the same game, on the same build.
+uint64_t world_digest(World *w);
+
+void init_world_snapshot(WorldSnapshot *s, WorldConfig config);
+
+void free_world_snapshot(WorldSnapshot *s);
+
+void take_world_snapshot(WorldSnapshot *s, World *w);
+
+// w keeps its buffers, profiler and arena, and must have room for the
+// snapshot's entities.
+void restore_world_snapshot(World *w, WorldSnapshot *s);
+
+bool write_world_snapshot(FILE *f, WorldSnapshot *s);
+
+// Initializes s from the file, free it with free_world_snapshot.
+bool read_world_snapshot(FILE *f, WorldSnapshot *s);